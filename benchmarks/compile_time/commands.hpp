@@ -0,0 +1,30 @@
+// SPDX-License-Identifier: BSL-1.0
+
+#pragma once
+
+// Defines a command with a few typed options, so that every command
+// instantiates the parse and help machinery. The generated sources invoke this
+// once per command after including wahl.
+#define COMPILE_TIME_COMMAND(i)                                                \
+  struct command_##i {                                                         \
+    int jobs = 1;                                                              \
+    bool verbose = false;                                                      \
+    std::string name = "";                                                     \
+    std::vector<std::string> files = {};                                       \
+                                                                               \
+    template <class F> void parse(F f) {                                       \
+      f(jobs, "--jobs", "-j");                                                 \
+      f(verbose, "--verbose", "-v", wahl::set(true));                          \
+      f(name, "--name", "-N", wahl::required());                               \
+      f(files);                                                                \
+    }                                                                          \
+                                                                               \
+    void run() {}                                                              \
+  };                                                                           \
+                                                                               \
+  int parse_##i(int argc, const char *argv[]) {                                \
+    auto cmd = command_##i{};                                                  \
+    auto r = wahl::parse(std::nothrow, cmd,                                    \
+                         std::deque<std::string>(argv + 1, argv + argc));      \
+    return r ? 0 : 1;                                                          \
+  }
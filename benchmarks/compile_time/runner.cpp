@@ -0,0 +1,102 @@
+// SPDX-License-Identifier: BSL-1.0
+
+// Measures how long it takes to rebuild a single translation unit. For every
+// target, the runner touches its source file and times an incremental build of
+// that target, so that only the translation unit itself is recompiled. The
+// results are written as JSON.
+//
+// Usage: runner --cmake <path> --build-dir <dir> [--runs N] [--output <file>]
+//               <label>=<target>:<source>...
+
+#include <algorithm>
+#include <chrono>
+#include <cstdlib>
+#include <filesystem>
+#include <fstream>
+#include <iostream>
+#include <string>
+#include <vector>
+
+namespace {
+
+struct measurement {
+  std::string label;
+  std::string target;
+  std::string source;
+  std::vector<double> seconds = {};
+};
+
+bool rebuild(const std::string &cmake, const std::string &build_dir,
+             const measurement &m) {
+  auto command = '"' + cmake + "\" --build \"" + build_dir
+                 + "\" --target " + m.target + " > /dev/null";
+  return std::system(command.c_str()) == 0;
+}
+
+} // namespace
+
+int main(int argc, char *argv[]) {
+  auto cmake = std::string{};
+  auto build_dir = std::string{};
+  auto output = std::string{"compile_time.json"};
+  auto runs = 5;
+  auto measurements = std::vector<measurement>{};
+  for (int i = 1; i < argc; ++i) {
+    auto arg = std::string{argv[i]};
+    if (arg == "--cmake" and i + 1 < argc) {
+      cmake = argv[++i];
+    } else if (arg == "--build-dir" and i + 1 < argc) {
+      build_dir = argv[++i];
+    } else if (arg == "--runs" and i + 1 < argc) {
+      runs = std::max(1, std::atoi(argv[++i]));
+    } else if (arg == "--output" and i + 1 < argc) {
+      output = argv[++i];
+    } else {
+      auto eq = arg.find('=');
+      auto colon = arg.find(':', eq);
+      if (eq == std::string::npos or colon == std::string::npos) {
+        std::cerr << "invalid measurement: " << arg << '\n';
+        return EXIT_FAILURE;
+      }
+      measurements.push_back({arg.substr(0, eq),
+                              arg.substr(eq + 1, colon - eq - 1),
+                              arg.substr(colon + 1)});
+    }
+  }
+  if (cmake.empty() or build_dir.empty() or measurements.empty()) {
+    std::cerr << "usage: runner --cmake <path> --build-dir <dir> [--runs N] "
+                 "[--output <file>] <label>=<target>:<source>...\n";
+    return EXIT_FAILURE;
+  }
+  for (auto &&m : measurements) {
+    // Build once so that the library and any module interface are up to date.
+    if (not rebuild(cmake, build_dir, m)) {
+      std::cerr << "failed to build " << m.target << '\n';
+      return EXIT_FAILURE;
+    }
+    for (int run = 0; run < runs; ++run) {
+      std::filesystem::last_write_time(
+        m.source, std::filesystem::file_time_type::clock::now());
+      auto start = std::chrono::steady_clock::now();
+      if (not rebuild(cmake, build_dir, m)) {
+        std::cerr << "failed to build " << m.target << '\n';
+        return EXIT_FAILURE;
+      }
+      auto stop = std::chrono::steady_clock::now();
+      m.seconds.push_back(std::chrono::duration<double>(stop - start).count());
+    }
+    std::sort(m.seconds.begin(), m.seconds.end());
+  }
+  auto out = std::ofstream{output};
+  out << "{\n  \"runs\": " << runs << ",\n  \"translation_units\": [\n";
+  for (std::size_t i = 0; i < measurements.size(); ++i) {
+    const auto &m = measurements[i];
+    out << "    {\"name\": \"" << m.label
+        << "\", \"min_s\": " << m.seconds.front()
+        << ", \"median_s\": " << m.seconds[m.seconds.size() / 2]
+        << ", \"max_s\": " << m.seconds.back() << "}"
+        << (i + 1 < measurements.size() ? "," : "") << '\n';
+  }
+  out << "  ]\n}\n";
+  return out ? EXIT_SUCCESS : EXIT_FAILURE;
+}
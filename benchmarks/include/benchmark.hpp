@@ -0,0 +1,42 @@
+// SPDX-License-Identifier: BSL-1.0
+
+#pragma once
+
+#include <algorithm>
+#include <chrono>
+#include <cstdio>
+#include <vector>
+
+namespace benchmark {
+
+// Prevents the compiler from optimizing away a computed value.
+template <class T> void do_not_optimize(T &&x) {
+#if defined(__GNUC__) || defined(__clang__)
+  asm volatile("" : : "g"(&x) : "memory");
+#else
+  static volatile const void *sink;
+  sink = &x;
+#endif
+}
+
+// Runs `f` in batches and reports the median time per iteration.
+template <class F>
+double run(const char *name, F &&f, int iterations = 10000, int batches = 9) {
+  using clock = std::chrono::steady_clock;
+  for (int i = 0; i < iterations / 10 + 1; ++i)
+    f();
+  std::vector<double> samples;
+  for (int batch = 0; batch < batches; ++batch) {
+    auto start = clock::now();
+    for (int i = 0; i < iterations; ++i)
+      f();
+    std::chrono::duration<double, std::nano> elapsed = clock::now() - start;
+    samples.push_back(elapsed.count() / iterations);
+  }
+  std::sort(samples.begin(), samples.end());
+  auto median = samples[samples.size() / 2];
+  std::printf("%-48s %12.1f ns/iter\n", name, median);
+  return median;
+}
+
+} // namespace benchmark
@@ -0,0 +1,32 @@
+# SPDX-License-Identifier: BSL-1.0
+
+# Writes the text, data, and bss sizes of binaries as JSON.
+#
+# Usage: cmake -D SIZE=<size> -D OUTPUT=<file>
+#              -D BINARIES=<name>=<path>,... -P report.cmake
+
+string(REPLACE "," ";" binaries "${BINARIES}")
+set(entries)
+foreach (binary IN LISTS binaries)
+  string(FIND "${binary}" "=" eq)
+  string(SUBSTRING "${binary}" 0 ${eq} name)
+  math(EXPR start "${eq} + 1")
+  string(SUBSTRING "${binary}" ${start} -1 path)
+  execute_process(
+    COMMAND "${SIZE}" "${path}"
+    OUTPUT_VARIABLE output
+    RESULT_VARIABLE status)
+  if (NOT status EQUAL 0)
+    message(FATAL_ERROR "failed to read the size of ${path}")
+  endif ()
+  # The Berkeley format prints a header line, followed by text, data, bss.
+  string(REGEX MATCH "\n[ \t]*([0-9]+)[ \t]+([0-9]+)[ \t]+([0-9]+)" _
+         "${output}")
+  file(SIZE "${path}" file_size)
+  set(entry "    {\"name\": \"${name}\", \"text\": ${CMAKE_MATCH_1}, ")
+  string(APPEND entry "\"data\": ${CMAKE_MATCH_2}, \"bss\": ${CMAKE_MATCH_3}, ")
+  string(APPEND entry "\"file\": ${file_size}}")
+  list(APPEND entries "${entry}")
+endforeach ()
+string(REPLACE ";" ",\n" entries "${entries}")
+file(WRITE "${OUTPUT}" "{\n  \"binaries\": [\n${entries}\n  ]\n}\n")
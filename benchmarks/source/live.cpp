@@ -0,0 +1,85 @@
+// SPDX-License-Identifier: BSL-1.0
+
+#include <wahl/wahl.hpp>
+
+#include "benchmark.hpp"
+
+#include <atomic>
+#include <chrono>
+#include <memory>
+#include <thread>
+
+namespace {
+
+struct config {
+  int workers = 1;
+  std::string log = "info";
+
+  template <class F> void parse(F f) {
+    f(workers, "--workers", "-w");
+    f(log, "--log");
+  }
+
+  void run() {}
+};
+
+// Reloads the configuration in the background until it is destroyed.
+class reloader {
+public:
+  reloader(wahl::live<config> &live, std::chrono::microseconds interval)
+      : thread_([&live, interval, this] {
+          for (int i = 0; not done_; ++i) {
+            live.reload({"--workers", std::to_string(i % 64), "--log",
+                         "debug"});
+            std::this_thread::sleep_for(interval);
+          }
+        }) {}
+
+  ~reloader() {
+    done_ = true;
+    thread_.join();
+  }
+
+private:
+  std::atomic<bool> done_{false};
+  std::thread thread_;
+};
+
+} // namespace
+
+int main() {
+  auto plain = config{};
+  benchmark::run(
+      "plain read",
+      [&] {
+        auto workers = plain.workers;
+        benchmark::do_not_optimize(workers);
+      },
+      1000000);
+
+  auto shared = std::make_shared<const config>();
+  benchmark::run(
+      "std::atomic_load of a shared_ptr",
+      [&] {
+        auto snapshot = std::atomic_load(&shared);
+        auto workers = snapshot->workers;
+        benchmark::do_not_optimize(workers);
+      },
+      1000000);
+
+  auto live = wahl::live<config>{};
+  auto read = [&] {
+    auto snapshot = live.get();
+    auto workers = snapshot->workers;
+    benchmark::do_not_optimize(workers);
+  };
+  benchmark::run("live read, no reloads", read, 1000000);
+  {
+    auto background = reloader{live, std::chrono::milliseconds(1)};
+    benchmark::run("live read, reload every 1ms", read, 1000000);
+  }
+  {
+    auto background = reloader{live, std::chrono::microseconds(0)};
+    benchmark::run("live read, continuous reloads", read, 1000000);
+  }
+}
@@ -0,0 +1,77 @@
+// SPDX-License-Identifier: BSL-1.0
+
+#include <wahl/wahl.hpp>
+
+#include "benchmark.hpp"
+
+#include <array>
+#include <string>
+
+namespace {
+
+// A command with `N` integer options named --option-0 to --option-<N-1>.
+template <std::size_t N> struct wide_cmd {
+  std::array<int, N> values = {};
+
+  static const std::array<std::string, N> &names() {
+    static const auto result = [] {
+      std::array<std::string, N> result;
+      for (std::size_t i = 0; i < N; ++i)
+        result[i] = "--option-" + std::to_string(i);
+      return result;
+    }();
+    return result;
+  }
+
+  template <class F> void parse(F f) {
+    for (std::size_t i = 0; i < N; ++i)
+      f(values[i], names()[i]);
+  }
+
+  void run() { benchmark::do_not_optimize(values); }
+};
+
+// Gives every `stride`-th option of a command with `n` options a value.
+std::deque<std::string> every(std::size_t n, std::size_t stride) {
+  std::deque<std::string> result;
+  for (std::size_t i = 0; i < n; i += stride) {
+    result.push_back("--option-" + std::to_string(i));
+    result.push_back(std::to_string(i));
+  }
+  return result;
+}
+
+// Measures a whole parse, including building the context, and the scan alone
+// over a context that is built once.
+template <std::size_t N> void measure(std::size_t stride, int iterations) {
+  auto args = every(N, stride);
+  auto label = std::to_string(N) + " flags, " +
+               std::to_string(args.size() / 2) + " given";
+  benchmark::run(
+      ("parse, " + label).c_str(),
+      [&] {
+        wide_cmd<N> cmd;
+        wahl::parse_only(std::nothrow, cmd, args);
+      },
+      iterations);
+  wide_cmd<N> cmd;
+  auto ctx = wahl::build_context(cmd);
+  benchmark::run(
+      ("scan, " + label).c_str(),
+      [&] {
+        wahl::strict_arguments policy;
+        bool completed = false;
+        auto e = wahl::parse_arguments(ctx, cmd, args.begin(), args.end(),
+                                       policy, completed);
+        benchmark::do_not_optimize(e);
+      },
+      iterations * 10);
+}
+
+} // namespace
+
+int main() {
+  measure<30>(1, 2000);
+  measure<300>(3, 200);
+  measure<1000>(1, 50);
+}
@@ -0,0 +1,46 @@
+// SPDX-License-Identifier: BSL-1.0
+
+#include <wahl/wahl.hpp>
+
+#include "benchmark.hpp"
+
+namespace {
+
+struct serial_cmd {
+  std::vector<double> values;
+
+  template <class F> void parse(F f) { f(values); }
+
+  void run() { benchmark::do_not_optimize(values); }
+};
+
+struct parallel_cmd {
+  std::vector<double> values;
+
+  template <class F> void parse(F f) { f(values, wahl::parallel()); }
+
+  void run() { benchmark::do_not_optimize(values); }
+};
+
+} // namespace
+
+int main() {
+  std::deque<std::string> args;
+  for (int i = 0; i < 1000000; ++i)
+    args.push_back(std::to_string(i * 0.25));
+
+  benchmark::run(
+      "serial conversion, 1M values",
+      [&] {
+        serial_cmd cmd;
+        wahl::parse(cmd, args);
+      },
+      1, 5);
+  benchmark::run(
+      "parallel conversion, 1M values",
+      [&] {
+        parallel_cmd cmd;
+        wahl::parse(cmd, args);
+      },
+      1, 5);
+}
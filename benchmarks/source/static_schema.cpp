@@ -0,0 +1,105 @@
+// SPDX-License-Identifier: BSL-1.0
+
+#include <wahl/wahl.hpp>
+
+#include "benchmark.hpp"
+
+#include <cstdio>
+
+namespace {
+
+struct fields {
+  int count = 0;
+  double ratio = 0;
+  std::string name;
+  std::vector<int> ids;
+  bool verbose = false;
+  bool force = false;
+  std::vector<std::string> files;
+
+  void run() { benchmark::do_not_optimize(count); }
+};
+
+struct dynamic_cmd : fields {
+  template <class F> void parse(F f) {
+    f(count, "--count", "-C");
+    f(ratio, "--ratio", "-r");
+    f(name, "--name", "-N");
+    f(ids, "--id", "-I");
+    f(verbose, "--verbose", "-v", wahl::set(true));
+    f(force, "--force", "-f", wahl::set(true));
+    f(files);
+  }
+};
+
+struct static_cmd : fields {
+  static constexpr auto schema() {
+    return wahl::schema(wahl::option<&static_cmd::count>("--count", "-C"),
+                        wahl::option<&static_cmd::ratio>("--ratio", "-r"),
+                        wahl::option<&static_cmd::name>("--name", "-N"),
+                        wahl::option<&static_cmd::ids>("--id", "-I"),
+                        wahl::option<&static_cmd::verbose>("--verbose", "-v"),
+                        wahl::option<&static_cmd::force>("--force", "-f"),
+                        wahl::positional<&static_cmd::files>());
+  }
+};
+
+// Both commands must parse the input the same way, or the benchmark would
+// compare different work.
+bool parses(const std::deque<std::string> &a) {
+  dynamic_cmd x;
+  static_cmd y;
+  if (not wahl::parse(std::nothrow, x, a) or
+      not wahl::parse_static(std::nothrow, y, a.begin(), a.end()))
+    return false;
+  return x.count == y.count and x.ids == y.ids and x.files == y.files;
+}
+
+} // namespace
+
+int main() {
+  const std::deque<std::string> small = {"-vf", "--count=3", "--name", "x"};
+  const std::deque<std::string> mixed = {
+      "--count", "42",   "--ratio=0.5", "-Nhello", "-vf", "a.txt", "b.txt",
+      "c.txt",   "--id", "1",           "2",       "3",   "4"};
+  std::deque<std::string> large;
+  for (int i = 0; i < 1000; ++i)
+    large.push_back("--id=" + std::to_string(i));
+  for (const auto &a : {small, mixed, large}) {
+    if (not parses(a)) {
+      std::fprintf(stderr, "static_schema: the inputs do not parse\n");
+      return 1;
+    }
+  }
+
+  benchmark::run("dynamic context, 4 tokens", [&] {
+    dynamic_cmd cmd;
+    wahl::parse(cmd, small);
+  });
+  benchmark::run("static schema, 4 tokens", [&] {
+    static_cmd cmd;
+    wahl::parse_static(cmd, small);
+  });
+  benchmark::run("dynamic context, 13 tokens", [&] {
+    dynamic_cmd cmd;
+    wahl::parse(cmd, mixed);
+  });
+  benchmark::run("static schema, 13 tokens", [&] {
+    static_cmd cmd;
+    wahl::parse_static(cmd, mixed);
+  });
+  benchmark::run(
+      "dynamic context, 1000 tokens",
+      [&] {
+        dynamic_cmd cmd;
+        wahl::parse(cmd, large);
+      },
+      100);
+  benchmark::run(
+      "static schema, 1000 tokens",
+      [&] {
+        static_cmd cmd;
+        wahl::parse_static(cmd, large);
+      },
+      100);
+}
@@ -0,0 +1,37 @@
+// SPDX-License-Identifier: BSL-1.0
+
+// The entry point of the generated startup benchmark binaries. Prints the
+// number of registered commands and the timestamps of the first static
+// constructor, of entering main, and of the first dispatch to a command.
+
+#include "registry.hpp"
+
+#include <cstdio>
+#include <string>
+
+namespace {
+
+std::int64_t constructed = 0;
+
+#if defined(__GNUC__) || defined(__clang__)
+// Runs before the C++ static initializers of all translation units.
+__attribute__((constructor(101))) void record_construction() {
+  constructed = startup::now();
+}
+#endif
+
+} // namespace
+
+int main() {
+  auto entered = startup::now();
+  auto commands = registry::subcommands().size();
+  auto name = "command_" + std::to_string(commands - 1);
+  char const *argv[] = {"startup", name.c_str(), "--value", "1"};
+  if (not wahl::parse<registry>(4, argv))
+    return 1;
+  std::printf("%zu %lld %lld %lld\n", commands,
+              static_cast<long long>(constructed),
+              static_cast<long long>(entered),
+              static_cast<long long>(startup::dispatched));
+  return 0;
+}
@@ -0,0 +1,42 @@
+// SPDX-License-Identifier: BSL-1.0
+
+#pragma once
+
+#include <wahl/wahl.hpp>
+
+#include <cstdint>
+
+#include <time.h>
+
+namespace startup {
+
+// A monotonic timestamp in nanoseconds that is comparable across processes,
+// so that the runner can relate it to the time it forked the process.
+inline std::int64_t now() {
+  timespec ts;
+  clock_gettime(CLOCK_MONOTONIC, &ts);
+  return std::int64_t(ts.tv_sec) * 1000000000 + ts.tv_nsec;
+}
+
+// The time the first dispatched command ran.
+inline std::int64_t dispatched = 0;
+
+} // namespace startup
+
+struct registry : wahl::group<registry> {};
+
+// Defines a registered command with a single option. The generated sources
+// invoke this once per command.
+#define STARTUP_COMMAND(i)                                                     \
+  struct command_##i : registry::command<command_##i> {                        \
+    int value = 0;                                                             \
+                                                                               \
+    command_##i() {}                                                           \
+                                                                               \
+    template <class F> void parse(F f) { f(value, "--value", "-v"); }          \
+                                                                               \
+    void run(registry &) {                                                     \
+      if (startup::dispatched == 0)                                            \
+        startup::dispatched = startup::now();                                  \
+    }                                                                          \
+  };
@@ -0,0 +1,145 @@
+// SPDX-License-Identifier: BSL-1.0
+
+// Runs the startup benchmark binaries repeatedly with fork and exec, and
+// reports wall-clock startup, static-initialization, and first-dispatch times
+// as JSON.
+
+#include "registry.hpp"
+
+#include <algorithm>
+#include <fstream>
+#include <iostream>
+#include <numeric>
+#include <sstream>
+#include <string>
+#include <vector>
+
+#include <sys/wait.h>
+#include <unistd.h>
+
+namespace {
+
+struct sample {
+  std::int64_t wall = 0;
+  std::int64_t to_main = 0;
+  std::int64_t static_init = -1;
+  std::int64_t dispatch = 0;
+};
+
+// Forks and execs `binary`, and reads the timestamps it prints.
+bool measure(const std::string &binary, std::size_t &commands, sample &s) {
+  int fds[2];
+  if (pipe(fds) != 0)
+    return false;
+  auto forked = startup::now();
+  auto pid = fork();
+  if (pid < 0)
+    return false;
+  if (pid == 0) {
+    dup2(fds[1], STDOUT_FILENO);
+    close(fds[0]);
+    close(fds[1]);
+    char const *argv[] = {binary.c_str(), nullptr};
+    execv(argv[0], const_cast<char *const *>(argv));
+    _exit(127);
+  }
+  close(fds[1]);
+  std::string out;
+  char buffer[256];
+  for (ssize_t n; (n = read(fds[0], buffer, sizeof(buffer))) > 0;)
+    out.append(buffer, std::size_t(n));
+  close(fds[0]);
+  int status = 0;
+  waitpid(pid, &status, 0);
+  auto exited = startup::now();
+  if (not WIFEXITED(status) or WEXITSTATUS(status) != 0)
+    return false;
+
+  long long constructed = 0, entered = 0, dispatched = 0;
+  std::istringstream in(out);
+  if (not(in >> commands >> constructed >> entered >> dispatched))
+    return false;
+  s.wall = exited - forked;
+  s.to_main = entered - forked;
+  if (constructed > 0)
+    s.static_init = entered - constructed;
+  s.dispatch = dispatched - entered;
+  return true;
+}
+
+// Writes the statistics of one metric in microseconds.
+void write_metric(std::ostream &os, const char *name,
+                  std::vector<std::int64_t> xs) {
+  os << "      \"" << name << "\": ";
+  if (xs.empty() or xs.front() < 0) {
+    os << "null";
+    return;
+  }
+  std::sort(xs.begin(), xs.end());
+  auto us = [](double ns) { return ns / 1000; };
+  auto mean = std::accumulate(xs.begin(), xs.end(), 0.0) / xs.size();
+  os << "{\"min\": " << us(xs.front()) << ", \"median\": "
+     << us(xs[xs.size() / 2]) << ", \"mean\": " << us(mean)
+     << ", \"max\": " << us(xs.back()) << "}";
+}
+
+struct runner {
+  int runs = 50;
+  std::string output = "";
+  std::vector<std::string> binaries = {};
+
+  static const char *help() {
+    return "Measures the startup of wahl binaries with large registries.";
+  }
+
+  template <class F> void parse(F f) {
+    f(runs, "--runs", "-n", wahl::help("Runs per binary"));
+    f(output, "--output", "-o", wahl::help("Write the JSON report to a file"));
+    f(binaries, wahl::required());
+  }
+
+  void run() {
+    std::ostringstream os;
+    os << "{\n  \"benchmark\": \"startup\",\n  \"unit\": \"us\",\n"
+       << "  \"runs\": " << runs << ",\n  \"results\": [";
+    for (std::size_t i = 0; i < binaries.size(); ++i) {
+      std::size_t commands = 0;
+      std::vector<std::int64_t> wall, to_main, static_init, dispatch;
+      for (int run = 0; run < runs; ++run) {
+        sample s;
+        if (not measure(binaries[i], commands, s)) {
+          std::cerr << "Error: failed to run " << binaries[i] << std::endl;
+          std::exit(1);
+        }
+        wall.push_back(s.wall);
+        to_main.push_back(s.to_main);
+        static_init.push_back(s.static_init);
+        dispatch.push_back(s.dispatch);
+      }
+      os << (i == 0 ? "\n" : ",\n") << "    {\n      \"binary\": \""
+         << binaries[i] << "\",\n      \"commands\": " << commands << ",\n";
+      write_metric(os, "wall", wall);
+      os << ",\n";
+      write_metric(os, "time_to_main", to_main);
+      os << ",\n";
+      write_metric(os, "static_init", static_init);
+      os << ",\n";
+      write_metric(os, "first_dispatch", dispatch);
+      os << "\n    }";
+    }
+    os << "\n  ]\n}\n";
+
+    if (output.empty()) {
+      std::cout << os.str();
+    } else {
+      std::ofstream file(output);
+      file << os.str();
+    }
+  }
+};
+
+} // namespace
+
+int main(int argc, char const *argv[]) {
+  return wahl::parse<runner>(argc, argv) ? 0 : 1;
+}
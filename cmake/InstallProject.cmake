@@ -15,7 +15,7 @@ function (InstallProject)
     PROJECT
     "NO_VERSION_SUFFIX"
     "NAME;VERSION;INCLUDE_DIR;INCLUDE_DESTINATION;BINARY_DIR;COMPATIBILITY;VERSION_HEADER;NAMESPACE;LICENSE;README;CHANGELOG"
-    "DEPENDENCIES"
+    "DEPENDENCIES;MODULES"
     ${ARGN})
 
   if (DEFINED PROJECT_NO_VERSION_SUFFIX)
@@ -85,6 +85,13 @@ function (InstallProject)
     PUBLIC_HEADER DESTINATION "${PROJECT_INCLUDE_DESTINATION}"
                   COMPONENT Development)
 
+  # CMake modules with helper functions are included by the package config.
+  set(PROJECT_MODULE_NAMES)
+  foreach (module IN LISTS PROJECT_MODULES)
+    get_filename_component(module_name "${module}" NAME)
+    list(APPEND PROJECT_MODULE_NAMES "${module_name}")
+  endforeach ()
+
   configure_package_config_file(
     "${INSTALL_PROJECT_ROOT_PATH}/Config.cmake.in"
     "${PROJECT_BINARY_DIR}/CMakeFiles/${PROJECT_NAME}Config.cmake"
@@ -101,6 +108,7 @@ function (InstallProject)
     FILES
       "${PROJECT_BINARY_DIR}/CMakeFiles/${PROJECT_NAME}ConfigVersion.cmake"
       "${PROJECT_BINARY_DIR}/CMakeFiles/${PROJECT_NAME}Config.cmake"
+      ${PROJECT_MODULES}
     DESTINATION
       "${CMAKE_INSTALL_LIBDIR}/cmake/${PROJECT_NAME}${PROJECT_VERSION_SUFFIX}")
 
@@ -0,0 +1,55 @@
+# SPDX-License-Identifier: BSL-1.0
+
+include_guard(GLOBAL)
+
+# wahl_add_multicall_links(<target> NAMES <name>... [DESTINATION <dir>])
+#
+# Makes the multi-call executable <target> available under every <name>, so
+# that wahl::parse_multicall dispatches on the name it was invoked with. The
+# links are created next to the executable after every build and, with
+# DESTINATION, installed into <dir> relative to the install prefix. The
+# executable itself must be installed into the same directory. On Windows,
+# which does not reliably support symbolic links, the executable is copied
+# instead.
+function (wahl_add_multicall_links target)
+  cmake_parse_arguments(MULTICALL "" "DESTINATION" "NAMES" ${ARGN})
+  if (NOT MULTICALL_NAMES)
+    message(FATAL_ERROR "wahl_add_multicall_links requires NAMES")
+  endif ()
+
+  foreach (name IN LISTS MULTICALL_NAMES)
+    if (WIN32)
+      add_custom_command(TARGET ${target} POST_BUILD
+        COMMAND ${CMAKE_COMMAND} -E copy_if_different
+                "$<TARGET_FILE:${target}>"
+                "$<TARGET_FILE_DIR:${target}>/${name}${CMAKE_EXECUTABLE_SUFFIX}"
+        VERBATIM)
+    else ()
+      add_custom_command(TARGET ${target} POST_BUILD
+        COMMAND ${CMAKE_COMMAND} -E create_symlink
+                "$<TARGET_FILE_NAME:${target}>"
+                "$<TARGET_FILE_DIR:${target}>/${name}"
+        VERBATIM)
+    endif ()
+  endforeach ()
+
+  if (DEFINED MULTICALL_DESTINATION)
+    set(directory
+        "\$ENV{DESTDIR}\${CMAKE_INSTALL_PREFIX}/${MULTICALL_DESTINATION}")
+    foreach (name IN LISTS MULTICALL_NAMES)
+      if (WIN32)
+        set(link "${directory}/${name}${CMAKE_EXECUTABLE_SUFFIX}")
+        install(CODE "
+          message(STATUS \"Installing: ${link}\")
+          execute_process(COMMAND \"${CMAKE_COMMAND}\" -E copy_if_different
+            \"${directory}/$<TARGET_FILE_NAME:${target}>\" \"${link}\")")
+      else ()
+        set(link "${directory}/${name}")
+        install(CODE "
+          message(STATUS \"Installing: ${link}\")
+          file(CREATE_LINK \"$<TARGET_FILE_NAME:${target}>\" \"${link}\"
+               SYMBOLIC)")
+      endif ()
+    endforeach ()
+  endif ()
+endfunction ()
@@ -3,25 +3,50 @@
 #pragma once
 
 #include <algorithm>
+#include <array>
+#include <atomic>
+#include <chrono>
 #include <deque>
 #include <functional>
 #include <initializer_list>
+#include <limits>
+#include <iosfwd>
 #include <map>
-#include <numeric>
-#include <sstream>
+#include <memory>
 #include <string>
+#include <string_view>
+#include <tuple>
 #include <unordered_map>
+#include <utility>
 #include <vector>
 
-#include <iomanip>
-#include <iostream>
-
 #include <cassert>
+#include <cstdint>
+#include <cstdlib>
+#include <cstring>
+#include <new>
+#include <stdexcept>
 
 #if defined(_MSC_VER)
 #include <ciso646>
 #endif
 
+#if !defined(WAHL_EXCEPTIONS)
+#if defined(__cpp_exceptions) || defined(__EXCEPTIONS) || defined(_CPPUNWIND)
+#define WAHL_EXCEPTIONS 1
+#else
+#define WAHL_EXCEPTIONS 0
+#endif
+#endif
+
+// With WAHL_COMPACT, commands only describe themselves, and a single parse
+// engine in the library scans, dispatches, and renders help for all of them.
+// This trades a few indirect calls for much less code per command. All
+// translation units of a program must use the same setting.
+#if !defined(WAHL_COMPACT)
+#define WAHL_COMPACT 0
+#endif
+
 #define WAHL_RETURNS(...)                                                      \
   ->decltype(__VA_ARGS__) { return (__VA_ARGS__); }
 
@@ -97,41 +122,16 @@ template <class F, class... Ts> void each_arg(F f, Ts &&...xs) {
 }
 #endif
 
-inline std::vector<std::string> wrap(const std::string &text,
-                                     unsigned int line_length = 72) {
-  std::vector<std::string> output;
-  std::istringstream iss(text);
-
-  std::string line;
+std::vector<std::string> wrap(const std::string &text,
+                              unsigned int line_length = 72);
 
-  do {
-    std::string word;
-    iss >> word;
+std::string join(const std::vector<std::string> &xs, const std::string &delim);
 
-    if (line.length() + word.length() > line_length) {
-      output.push_back(line);
-      line.clear();
-    }
-    line += word + " ";
-
-  } while (iss);
-
-  if (!line.empty()) {
-    output.push_back(line);
-  }
-  return output;
-}
+// Prints a line to standard output.
+void print_line(std::string_view text);
 
-template <class Range> std::string join(Range &&r, std::string delim) {
-  return std::accumulate(std::begin(r), std::end(r), std::string(),
-                         [&](const std::string &x, const std::string &y) {
-                           if (x.empty())
-                             return y;
-                           if (y.empty())
-                             return x;
-                           return x + delim + y;
-                         });
-}
+// Prints "Error: " and the message to standard error.
+void print_error(std::string_view message);
 
 template <class Predicate> std::string trim(const std::string &s, Predicate p) {
   auto wsfront = std::find_if_not(s.begin(), s.end(), p);
@@ -182,17 +182,366 @@ template <class T> std::string get_command_type_name() {
 WAHL_GET_CMD_ATTRIBUTE(name, get_command_type_name<T>());
 WAHL_GET_CMD_ATTRIBUTE(help, "");
 WAHL_GET_CMD_ATTRIBUTE(options_metavar, "[options...]");
+WAHL_GET_CMD_ATTRIBUTE(abbreviations, false);
+
+enum class error_code {
+  none,
+  unknown_flag,
+  unknown_command,
+  ambiguous_flag,
+  ambiguous_command,
+  unexpected_value,
+  too_many_values,
+  missing_value,
+  missing_required,
+  invalid_value,
+  cannot_open_file,
+  cannot_read_file,
+  invalid_snapshot,
+  constraint_violation,
+  invalid_path,
+  cannot_load_plugin,
+  limit_exceeded,
+  custom,
+};
+
+// Describes why parsing failed. Errors carry the offending token and its
+// index in the parsed arguments, and format their message only on request.
+class error {
+public:
+  error() = default;
+
+  error(error_code code, std::string token, std::string detail = {})
+      : code_(code), token_(std::move(token)), detail_(std::move(detail)) {}
+
+  // An error with a preformatted message, e.g., from a user callback.
+  static error custom(std::string message) {
+    return {error_code::custom, {}, std::move(message)};
+  }
+
+  error_code code() const { return code_; }
+
+  // The index of the offending token, or -1 if the error is not caused by a
+  // single token.
+  int index() const { return index_; }
+
+  const std::string &token() const { return token_; }
+
+  explicit operator bool() const { return code_ != error_code::none; }
+
+  error &at(int index) {
+    if (index_ < 0)
+      index_ = index;
+    return *this;
+  }
+
+  // Moves the index of the offending token by `offset`, e.g., to make an
+  // error of a subcommand relative to the arguments of its parent.
+  error &shift(int offset) {
+    if (index_ >= 0)
+      index_ += offset;
+    return *this;
+  }
+
+  error &in(std::string (*command)()) {
+    if (command_ == nullptr)
+      command_ = command;
+    return *this;
+  }
+
+  std::string message() const;
+
+private:
+  error_code code_ = error_code::none;
+  int index_ = -1;
+  std::string token_;
+  std::string detail_;
+  std::string (*command_)() = nullptr;
+};
+
+// The outcome of a non-throwing parse.
+class result {
+public:
+  result() = default;
+
+  result(class error e) : error_(std::move(e)) {}
+
+  explicit operator bool() const { return not error_; }
+
+  const class error &error() const { return error_; }
+
+private:
+  class error error_;
+};
+
+// The exception thrown by the throwing parse functions.
+class parse_error : public std::runtime_error {
+public:
+  explicit parse_error(class error e)
+      : std::runtime_error(e.message()), error_(std::move(e)) {}
+
+  const class error &error() const { return error_; }
+
+private:
+  class error error_;
+};
+
+// Throws the error as a parse_error. Without exception support, prints the
+// error and aborts instead; use the std::nothrow overloads of the parse
+// functions to handle errors in that configuration.
+[[noreturn]] inline void raise(error e) {
+#if WAHL_EXCEPTIONS
+  throw parse_error(std::move(e));
+#else
+  wahl::print_error(e.message());
+  std::abort();
+#endif
+}
+
+error &pending_error() noexcept;
+
+// Reports an error from a value writer or a callback. Parsing stops after the
+// current argument, and the first reported error wins.
+void fail(error e);
+
+error take_pending_error();
+
+// Hard limits for parsing untrusted arguments, where zero means unlimited.
+// The arguments are checked before they are tokenized, so that a hostile
+// input is rejected before parsing allocates anything in proportion to it.
+struct limits {
+  std::size_t max_tokens = 0;
+  std::size_t max_token_length = 0;
+  // The number of values of a single argument, including values streamed
+  // from files.
+  std::size_t max_values = 0;
+  // The number of nested commands, counting the top-level one.
+  std::size_t max_depth = 0;
+  // The total length of all tokens.
+  std::size_t max_bytes = 0;
+  // The bytes that parsing may store, estimated as the size of the token
+  // stream plus the length and a string's footprint for every value.
+  std::size_t memory_budget = 0;
+};
+
+// Applies limits to all parses on the current thread while it lives,
+// including the parses of subcommands.
+class limit_scope {
+public:
+  explicit limit_scope(const limits &l) noexcept;
+
+  limit_scope(const limit_scope &) = delete;
+  limit_scope &operator=(const limit_scope &) = delete;
+
+  ~limit_scope();
+
+private:
+  limits limits_;
+  const limits *previous_limits_;
+  std::size_t previous_depth_;
+  std::size_t previous_used_;
+};
+
+// The limits of the current thread, or null.
+const limits *active_limits() noexcept;
+
+// Charges `bytes` against the memory budget of the active limits.
+error charge_memory(std::size_t bytes);
+
+// Reads a value with `read` from a string stream over `x`, and reports
+// whether the stream is still good afterwards. This keeps <sstream> out of
+// the header.
+bool read_from_stream(const std::string &x,
+                      void (*read)(std::istream &, void *), void *result);
+
+// Reads a value like `std::istringstream(x) >> result` would. The overloads
+// for arithmetic types and strings are compiled into the library.
+bool parse_value(const std::string &x, bool &result);
+bool parse_value(const std::string &x, char &result);
+bool parse_value(const std::string &x, signed char &result);
+bool parse_value(const std::string &x, unsigned char &result);
+bool parse_value(const std::string &x, short &result);
+bool parse_value(const std::string &x, unsigned short &result);
+bool parse_value(const std::string &x, int &result);
+bool parse_value(const std::string &x, unsigned int &result);
+bool parse_value(const std::string &x, long &result);
+bool parse_value(const std::string &x, unsigned long &result);
+bool parse_value(const std::string &x, long long &result);
+bool parse_value(const std::string &x, unsigned long long &result);
+bool parse_value(const std::string &x, float &result);
+bool parse_value(const std::string &x, double &result);
+bool parse_value(const std::string &x, long double &result);
+bool parse_value(const std::string &x, std::string &result);
+
+// Reads other types with their `operator>>`, which requires <istream>.
+template <class T> bool parse_value(const std::string &x, T &result) {
+  return wahl::read_from_stream(
+      x, [](std::istream &is, void *p) { is >> *static_cast<T *>(p); },
+      &result);
+}
 
 template <class T> struct value_parser {
   static T apply(const std::string &x) {
     T result;
-    std::stringstream ss;
-    ss.str(x);
-    ss >> result;
+    parse(x, result);
+    return result;
+  }
+
+  // Like apply, but reports whether `x` could be converted at all.
+  static bool parse(const std::string &x, T &result) {
+    return wahl::parse_value(x, result);
+  }
+};
+
+template <class T>
+auto convert_value(rank<1>, const std::string &x, T &result)
+    WAHL_RETURNS(value_parser<T>::parse(x, result));
+
+template <class T>
+bool convert_value(rank<0>, const std::string &x, T &result) {
+  result = value_parser<T>::apply(x);
+  return true;
+}
+
+// Converts `x` with value_parser<T>, returning false for values that cannot
+// be converted. Specializations that only provide `apply` never fail.
+template <class T> bool convert_value(const std::string &x, T &result) {
+  return wahl::convert_value(rank<1>{}, x, result);
+}
+
+// Parses a duration like "250ms", "1.5h", or "1h30m" into nanoseconds. The
+// units are ns, us, ms, s, m (or min), h, and d. Returns false for malformed
+// values, values that are not a whole number of nanoseconds, and overflows.
+bool parse_duration(std::string_view x, std::int64_t &nanoseconds);
+
+// Parses a size like "512", "64KiB", or "1.5GB" into bytes. The units are B,
+// the SI units kB (or KB) to EB, and the IEC units KiB to EiB. Units are
+// case-sensitive otherwise.
+bool parse_byte_size(std::string_view x, std::uint64_t &bytes);
+
+// Parses a count like "250", "10k", or "2.5M" with an optional SI suffix
+// from k (or K) to E.
+bool parse_quantity(std::string_view x, std::uint64_t &value);
+
+// Parses a rate like "10k/s", "500/100ms", or "1M/h" into a count per
+// period. A rate without a period is per second.
+bool parse_rate(std::string_view x, std::uint64_t &count,
+                std::int64_t &period_nanoseconds);
+
+// Converts nanoseconds into a duration, rejecting values that the duration
+// cannot represent exactly.
+template <class Rep, class Period>
+bool from_nanoseconds(std::int64_t nanoseconds,
+                      std::chrono::duration<Rep, Period> &result) {
+  using duration = std::chrono::duration<Rep, Period>;
+  if constexpr (std::is_floating_point<Rep>{}) {
+    result = std::chrono::duration_cast<duration>(
+        std::chrono::duration<long double, std::nano>(nanoseconds));
+    return true;
+  } else {
+    // The number of ticks per nanosecond.
+    using ratio = std::ratio_divide<std::nano, Period>;
+    auto n = static_cast<std::intmax_t>(nanoseconds);
+    constexpr auto max = std::numeric_limits<std::intmax_t>::max();
+    if (n > max / ratio::num or n < -(max / ratio::num))
+      return false;
+    n *= ratio::num;
+    if (n % ratio::den != 0)
+      return false;
+    n /= ratio::den;
+    if (n < 0 and std::is_unsigned<Rep>{})
+      return false;
+    if (n > 0 and static_cast<std::uintmax_t>(n) >
+                      static_cast<std::uintmax_t>(
+                          std::numeric_limits<Rep>::max()))
+      return false;
+    if (n < 0 and n < static_cast<std::intmax_t>(
+                          std::numeric_limits<Rep>::min()))
+      return false;
+    result = duration(static_cast<Rep>(n));
+    return true;
+  }
+}
+
+// A number of bytes, written as "512", "64KiB", or "1.5GB".
+struct byte_size {
+  std::uint64_t bytes = 0;
+};
+
+// A count with an optional SI suffix, written as "250", "10k", or "2.5M".
+struct quantity {
+  std::uint64_t value = 0;
+};
+
+// A count per period, written as "10k/s", "500/100ms", or "1M/h".
+struct rate {
+  std::uint64_t count = 0;
+  std::chrono::nanoseconds period = std::chrono::seconds(1);
+
+  double per_second() const {
+    return static_cast<double>(count) * 1e9 /
+           static_cast<double>(period.count());
+  }
+};
+
+// The value parser of the unit types above. Invalid values are reported as
+// errors of the argument they were given for.
+template <class T, class Derived> struct unit_value_parser {
+  static T apply(const std::string &x) {
+    T result = {};
+    if (not Derived::parse(x, result))
+      wahl::fail({error_code::invalid_value, x});
     return result;
   }
 };
 
+template <class Rep, class Period>
+struct value_parser<std::chrono::duration<Rep, Period>>
+    : unit_value_parser<std::chrono::duration<Rep, Period>,
+                        value_parser<std::chrono::duration<Rep, Period>>> {
+  static const char *metavar() { return "duration"; }
+
+  static bool parse(const std::string &x,
+                    std::chrono::duration<Rep, Period> &result) {
+    std::int64_t nanoseconds = 0;
+    return wahl::parse_duration(x, nanoseconds) and
+           wahl::from_nanoseconds(nanoseconds, result);
+  }
+};
+
+template <>
+struct value_parser<byte_size>
+    : unit_value_parser<byte_size, value_parser<byte_size>> {
+  static const char *metavar() { return "size"; }
+
+  static bool parse(const std::string &x, byte_size &result) {
+    return wahl::parse_byte_size(x, result.bytes);
+  }
+};
+
+template <>
+struct value_parser<quantity>
+    : unit_value_parser<quantity, value_parser<quantity>> {
+  static const char *metavar() { return "count"; }
+
+  static bool parse(const std::string &x, quantity &result) {
+    return wahl::parse_quantity(x, result.value);
+  }
+};
+
+template <>
+struct value_parser<rate> : unit_value_parser<rate, value_parser<rate>> {
+  static const char *metavar() { return "rate"; }
+
+  static bool parse(const std::string &x, rate &result) {
+    std::int64_t period = 0;
+    if (not wahl::parse_rate(x, result.count, period))
+      return false;
+    result.period = std::chrono::nanoseconds(period);
+    return true;
+  }
+};
+
 template <class T,
           typename std::enable_if<(not is_container<T>{} or
                                    std::is_convertible<T, std::string>{}),
@@ -213,6 +562,54 @@ inline void write_value_to(std::nullptr_t, const std::string &) {
   // Do nothing
 }
 
+// Calls `f` with every line of the file at `path`, or of standard input for
+// "-", until it returns false. Lines are read in fixed-size chunks into a
+// single reused buffer, and a trailing carriage return is stripped.
+error for_each_line(const std::string &path,
+                    const std::function<bool(const std::string &)> &f);
+
+// Streams newline-separated values from the file at `path`, or from standard
+// input for "-", into a container, so that reading millions of values does
+// not allocate a string per value. Blank lines are skipped, and strings keep
+// the whole line.
+template <class Container>
+void read_values_from(const std::string &path, Container &result) {
+  using value_type = typename Container::value_type;
+  std::size_t line_number = 0;
+  std::size_t values = 0;
+  auto e = wahl::for_each_line(path, [&](const std::string &line) {
+    ++line_number;
+    if (line.find_first_not_of(" \t") == std::string::npos)
+      return true;
+    if (auto l = wahl::active_limits();
+        l != nullptr and l->max_values != 0 and values++ >= l->max_values) {
+      wahl::fail({error_code::limit_exceeded, path,
+                  "more than " + std::to_string(l->max_values) + " values"});
+      return false;
+    }
+    if (auto over = wahl::charge_memory(line.size() + sizeof(std::string))) {
+      wahl::fail(std::move(over));
+      return false;
+    }
+    // Strings take the whole line, spaces included, without a stream.
+    if constexpr (std::is_same<value_type, std::string>()) {
+      result.insert(result.end(), line);
+      return true;
+    }
+    value_type value;
+    if (not wahl::convert_value(line, value)) {
+      auto name = path == "-" ? std::string("<stdin>") : path;
+      wahl::fail({error_code::invalid_value, line,
+                  name + ":" + std::to_string(line_number)});
+      return false;
+    }
+    result.insert(result.end(), std::move(value));
+    return true;
+  });
+  if (e)
+    wahl::fail(std::move(e));
+}
+
 enum class argument_type { none, single, multiple };
 
 template <class T> argument_type get_argument_type(const T &) {
@@ -237,28 +634,139 @@ template <class T> std::string type_to_help_impl(rank<0>) {
     return "argument";
 }
 
+// Value parsers may name the type of their values with `metavar()`.
+template <class T>
+auto type_to_help_impl(rank<2>)
+    WAHL_RETURNS(std::string(value_parser<T>::metavar()));
+
 template <class T>
 auto type_to_help_impl(rank<1>) ->
     typename std::enable_if<(is_container<T>() and
                              not std::is_convertible<T, std::string>()),
                             std::string>::type {
-  return wahl::type_to_help_impl<value_of<T>>(rank<1>{}) + "...";
+  return wahl::type_to_help_impl<value_of<T>>(rank<2>{}) + "...";
 }
 
 template <class T> std::string type_to_help(const T &) {
-  return "[" + wahl::type_to_help_impl<T>(rank<1>{}) + "]";
+  return "[" + wahl::type_to_help_impl<T>(rank<2>{}) + "]";
 }
 
+// The phases of a parse that heap allocations are attributed to.
+enum class parse_phase {
+  none,
+  context_build,
+  tokenization,
+  value_write,
+  callback,
+};
+
+constexpr std::size_t parse_phase_count = 5;
+
+struct allocation_counters {
+  std::array<std::size_t, parse_phase_count> allocations = {};
+  std::array<std::size_t, parse_phase_count> bytes = {};
+
+  std::size_t allocations_in(parse_phase phase) const {
+    return allocations[static_cast<std::size_t>(phase)];
+  }
+
+  std::size_t bytes_in(parse_phase phase) const {
+    return bytes[static_cast<std::size_t>(phase)];
+  }
+
+  // Sums the allocations of all phases that belong to a parse.
+  std::size_t parse_allocations() const;
+
+  std::size_t parse_bytes() const;
+};
+
+parse_phase &current_parse_phase() noexcept;
+
+// The allocation counters of the calling thread.
+allocation_counters &allocation_stats() noexcept;
+
+void reset_allocation_stats() noexcept;
+
+// Attributes an allocation of `size` bytes to the current parse phase. wahl
+// does not replace the global allocation functions itself; call this from a
+// replacement `operator new` to enable allocation accounting.
+void record_allocation(std::size_t size) noexcept;
+
+// Sets the current parse phase for the lifetime of the scope.
+class phase_scope {
+public:
+  explicit phase_scope(parse_phase phase) noexcept
+    : previous_(current_parse_phase()) {
+    current_parse_phase() = phase;
+  }
+
+  phase_scope(const phase_scope &) = delete;
+  phase_scope &operator=(const phase_scope &) = delete;
+
+  ~phase_scope() { current_parse_phase() = previous_; }
+
+private:
+  parse_phase previous_;
+};
+
+// A fixed set of worker threads that run batches of independent tasks. One
+// batch runs at a time; the calling thread works on its batch as well, and
+// batches started from within a task run inline to avoid deadlocks. Tasks
+// must not throw.
+class thread_pool {
+public:
+  // Uses one thread per hardware thread for 0.
+  explicit thread_pool(unsigned threads = 0);
+
+  thread_pool(const thread_pool &) = delete;
+  thread_pool &operator=(const thread_pool &) = delete;
+
+  ~thread_pool();
+
+  // The number of threads working on a batch, including the caller.
+  std::size_t size() const;
+
+  // Calls f(0), ..., f(n - 1) and returns once all calls have finished.
+  template <class F> void run(std::size_t n, F f) {
+    run_batch(n, [](void *f, std::size_t i) { (*static_cast<F *>(f))(i); },
+              &f);
+  }
+
+  // A pool with one thread per hardware thread, created on first use.
+  static thread_pool &shared();
+
+private:
+  struct state;
+
+  void run_batch(std::size_t n, void (*task)(void *, std::size_t), void *f);
+
+  std::unique_ptr<state> state_;
+};
+
+// An argument as declared by a command. Attributes adjust it before it is
+// added to a context, which then moves the data needed for every token into
+// an argument_slot.
 struct argument {
   argument_type type;
   std::vector<std::string> flags;
 
+  // How often the argument was given. Updated from the slot once the scan is
+  // done, and before eager callbacks run.
   int count = 0;
   bool required = false;
   std::function<void(const std::string &)> write_value;
+  // Set by wahl::parallel(). Converts the collected tokens in one go, and
+  // returns the position of the first invalid one, or -1.
+  std::function<std::ptrdiff_t(const std::vector<std::string_view> &)>
+      write_values;
+  // The tokens collected for write_values, as their index in the parsed
+  // arguments and the offset of the value within the token.
+  std::vector<std::pair<int, std::size_t>> deferred;
   std::vector<std::function<void(const argument &)>> callbacks;
   std::vector<std::function<void(const argument &)>> eager_callbacks;
   std::string help, metavar;
+  // Describes a default that is computed only if the argument is not given.
+  std::string default_description;
 
   template <class F> void add_callback(F f) {
     callbacks.emplace_back(std::move(f));
@@ -268,344 +776,1999 @@ struct argument {
     eager_callbacks.emplace_back(std::move(f));
   }
 
-  std::string get_flags() const {
-    std::string result = join(flags, ", ");
-    if (type != argument_type::none)
-      result += " " + metavar;
-    return result;
-  }
-
-  bool write(const std::string &s) {
-    this->write_value(s);
-    count++;
-    for (auto &&f : eager_callbacks)
-      f(*this);
-    return not eager_callbacks.empty();
-  }
+  std::string get_flags() const;
 };
 
-template <class... Args> struct subcommand {
-  std::string help;
-  std::function<void(std::deque<std::string>, Args...)> run;
+// The part of an argument that the scan touches for every token. Contexts keep
+// the slots in a dense array next to the arguments, so that scanning does not
+// pull flags, help texts, and callbacks into the cache.
+struct argument_slot {
+  argument_type type = argument_type::none;
+  // Whether parsing stops after the argument's eager callbacks.
+  bool eager = false;
+  // Whether the values are collected for wahl::parallel().
+  bool deferred = false;
+  int count = 0;
+  std::function<void(const std::string &)> write_value;
 };
 
-template <class T, class... Args> auto current_name() { return get_name<T>(); }
+// A compact trie over a set of keys that resolves unambiguous prefixes in
+// time proportional to the length of the prefix. Every key carries a value,
+// and a prefix is unambiguous if all keys starting with it share one value,
+// so that aliases of the same argument never conflict with each other.
+class prefix_trie {
+public:
+  static constexpr int none = -1;
+  static constexpr int ambiguous = -2;
 
-template <class... Args> struct context {
-  using subcommand_type = subcommand<Args...>;
-  using subcommand_map = std::map<std::string, subcommand_type>;
-  std::vector<argument> arguments;
-  std::unordered_map<std::string, int> lookup;
-  subcommand_map subcommands;
+  void insert(std::string key, int value);
 
-  bool has_subcommand(const std::string &argv) {
-    return subcommands.find(argv) != subcommands.end() and
-           argv != current_name<Args...>();
-  }
+  // Returns the id of the key matching `prefix`, which is either the key
+  // equal to `prefix` or the only key that `prefix` abbreviates.
+  int find(std::string_view prefix) const;
 
-  bool has_default_capture() { return lookup.find("") != lookup.end(); }
+  const std::string &key(int id) const { return keys[id]; }
 
-  void add(argument arg) {
-    if (arg.flags.empty())
-      lookup[""] = arguments.size();
-    else
-      for (auto &&name : arg.flags)
-        lookup[name] = arguments.size();
-    arguments.emplace_back(std::move(arg));
-  }
+  int value(int id) const { return values[id]; }
 
-  template <class T, class... Ts> void parse(T &&x, Ts &&...xs) {
-    argument arg;
-    arg.write_value = [&x](const std::string &s) {
-      wahl::write_value_to(x, s);
-    };
-    arg.type = wahl::get_argument_type(x);
-    arg.metavar = wahl::type_to_help(x);
-    wahl::each_arg(
-        wahl::overload(
-            [&](const std::string &name) { arg.flags.push_back(name); },
-            [&, this](auto &&attribute) -> decltype(attribute(x, *this, arg),
-                                                    void()) {
-              attribute(x, *this, arg);
-            }),
-        std::forward<Ts>(xs)...);
-    this->add(std::move(arg));
-  }
-
-  argument &operator[](const std::string &flag) {
-    if (lookup.find(flag) == lookup.end()) {
-      throw std::runtime_error(current_name<Args...>() +
-                               ": unknown flag: " + flag);
-    }
-    // else
-    return arguments[lookup.at(flag)];
-  }
+  // Lists the shortest key of every distinct value starting with `prefix`.
+  std::vector<std::string> candidates(std::string_view prefix) const;
 
-  const argument &operator[](const std::string &flag) const {
-    if (lookup.find(flag) == lookup.end()) {
-      throw std::runtime_error(current_name<Args...>() +
-                               ": unknown flag: " + flag);
-    }
-    // else
-    return arguments[lookup.at(flag)];
-  }
-
-  void show_help_col(std::string item, std::string help, int width,
-                     int total_width) const {
-    auto txt = wahl::wrap(help, total_width - width - 2);
-    assert(!txt.empty());
-    std::cout << " " << std::setw(width) << item << " " << txt[0] << std::endl;
-    std::for_each(txt.begin() + 1, txt.end(), [&](std::string line) {
-      std::cout << " " << std::setw(width) << " "
-                << " " << line << std::endl;
-    });
-  }
+private:
+  struct node {
+    char c;
+    int child = -1;
+    int sibling = -1;
+    int key = -1;
+    int unique = none;
+  };
 
-  void show_help(std::string name, std::string description,
-                 std::string options_metavar) const {
-    const int total_width = 80;
-    std::vector<std::string> flags;
-    int width = 0;
-    for (auto &&arg : arguments) {
-      std::string flag = arg.get_flags();
-      width = std::max(width, int(flag.size()));
-      flags.push_back(std::move(flag));
-    }
-    for (auto &&p : subcommands)
-      width = std::max(width, int(p.first.size()));
-    std::cout << "Usage: " << name << " " << options_metavar;
-
-    if (subcommands.size() > 0)
-      std::cout << " [command]";
-    if (lookup.count("") > 0)
-      std::cout << " " << (*this)[""].metavar;
-
-    std::cout << std::endl;
-    std::cout << std::endl;
-    for (auto line : wahl::wrap(description, total_width - 2))
-      std::cout << "  " << line << std::endl;
-    std::cout << std::endl;
-    std::cout << "Options: " << std::endl << std::endl;
-    // TODO: Switch to different format when width > 40
-    for (auto &&arg : arguments) {
-      this->show_help_col(arg.get_flags(), arg.help, width, total_width);
-    }
-    if (subcommands.size() > 0) {
-      std::cout << std::endl;
-      std::cout << "Commands: " << std::endl << std::endl;
-      for (auto &&p : subcommands) {
-        this->show_help_col(p.first, p.second.help, width, total_width);
-      }
-    }
-    std::cout << std::endl;
-  }
+  int root();
+  int find_child(int n, char c) const;
+  int add_child(int n, char c);
+  void mark(int n, int id, int value);
 
-  void post_process() {
-    for (auto &&arg : arguments) {
-      for (auto &&f : arg.callbacks)
-        f(arg);
-    }
-  }
+  std::vector<node> nodes;
+  std::vector<std::string> keys;
+  std::vector<int> values;
 };
 
-template <class F> auto callback(F f) {
-  return [f](auto &&data, auto &ctx, argument &a) {
-    a.add_callback(
-        [f, &ctx, &data](const argument &arg) { f(data, ctx, arg); });
-  };
+// Converts `tokens` into a container, splitting them into chunks of at least
+// `grain` tokens that are converted on the shared thread pool. The values are
+// appended in the order of the tokens. Returns the position of the first
+// token that could not be converted, or -1; the container is left unchanged
+// in that case.
+template <class T>
+std::ptrdiff_t convert_values(const std::vector<std::string_view> &tokens,
+                              T &result, std::size_t grain) {
+  using value_type = typename T::value_type;
+  auto &pool = thread_pool::shared();
+  grain = std::max<std::size_t>(grain, 1);
+  auto chunks = std::min(pool.size(), (tokens.size() + grain - 1) / grain);
+  if (chunks == 0)
+    return -1;
+  std::vector<std::vector<value_type>> values(chunks);
+  std::vector<std::ptrdiff_t> invalid(chunks, -1);
+  pool.run(chunks, [&](std::size_t chunk) {
+    auto first = tokens.size() * chunk / chunks;
+    auto last = tokens.size() * (chunk + 1) / chunks;
+    auto &out = values[chunk];
+    out.resize(last - first);
+    std::string buffer;
+    for (auto i = first; i < last; ++i) {
+      buffer.assign(tokens[i]);
+      if (not wahl::convert_value(buffer, out[i - first])) {
+        invalid[chunk] = std::ptrdiff_t(i);
+        return;
+      }
+    }
+  });
+  for (auto i : invalid)
+    if (i >= 0)
+      return i;
+  for (auto &&chunk : values)
+    for (auto &&x : chunk)
+      result.insert(result.end(), std::move(x));
+  return -1;
 }
 
-template <class F> auto eager_callback(F f) {
-  return [f](auto &&data, auto &ctx, argument &a) {
-    a.add_eager_callback(
-        [f, &data, &ctx](const argument &arg) { f(data, ctx, arg); });
-  };
-}
+// The function a plugin library exports for a command. It parses the
+// arguments into a new command, runs it with `parent`, and stores the outcome.
+using plugin_entry = void (*)(const std::deque<std::string> &args,
+                              void *parent, result &out);
 
-template <class F> auto lazy_callback(F f) {
-  return [f](auto &&data, auto &ctx, argument &a) {
-    a.add_callback([f, &ctx, &data](const argument &arg) {
-      if (arg.count > 0)
-        f(data, ctx, arg);
-    });
-  };
-}
+// A subcommand that is implemented by a shared library. The library is opened
+// when the subcommand is first dispatched, and stays loaded afterwards.
+class plugin {
+public:
+  // The symbol defaults to the one that WAHL_PLUGIN exports for `name`.
+  plugin(const std::string &name, std::string path, std::string symbol = {});
 
-template <class F> auto action(F f) {
-  return wahl::eager_callback(std::bind(f));
-}
+  const std::string &path() const { return path_; }
 
-template <class T> auto show(T text) {
-  return action([=] { std::cout << text << std::endl; });
-}
+  const std::string &symbol() const { return symbol_; }
 
-inline auto required() {
-  return [](auto &&, auto &, argument &a) {
-    a.required = true;
-    a.add_callback([](const argument &arg) {
-      if (arg.required and arg.count == 0)
-        throw std::runtime_error("required arg missing: " + arg.get_flags());
-    });
-  };
-}
+  bool loaded() const;
 
-template <class T> auto set(T value) {
-  return [value](auto &&data, auto &, argument &a) {
-    a.type = argument_type::none;
-    a.write_value = [&data, value](const std::string &) { data = value; };
-  };
-}
+  // Loads the library if needed, and parses and runs the command.
+  result run(const std::deque<std::string> &args, void *parent) const;
 
-inline auto count() {
-  return [](auto &&data, auto &, argument &a) {
-    a.type = argument_type::none;
-    a.add_callback([&data](const argument &arg) { data = arg.count; });
-    a.write_value = [](const std::string &) {};
-  };
-}
+private:
+  std::string path_;
+  std::string symbol_;
+  mutable plugin_entry entry_ = nullptr;
+};
 
-#define WAHL_SET_ARG(name)                                                     \
-  template <class T> auto name(T &&x) {                                        \
-    return [=](auto &&, auto &, argument &a) { a.name = x; };                  \
+// A subcommand of a group's manifest.
+struct plugin_manifest_entry {
+  std::string name;
+  std::string path;
+  std::string help;
+};
+
+// Reads a plugin manifest. Every line names a subcommand, the library that
+// implements it, and its help text, separated by whitespace, as in
+// `deploy plugins/libdeploy.so Deploy the build`. Relative paths are relative
+// to the manifest, and blank lines and lines starting with '#' are skipped.
+error read_plugin_manifest(const std::string &path,
+                           std::vector<plugin_manifest_entry> &result);
+
+// The flags of a command with their help texts, for the help search.
+using flag_help_list = std::vector<std::pair<std::string, std::string>>;
+
+// Rejects unknown arguments. After a `--` terminator, all remaining arguments
+// are positional.
+struct strict_arguments {
+  template <class Iterator> bool unknown(Iterator) { return false; }
+  template <class Iterator> bool terminate(Iterator) { return false; }
+  template <class Iterator> bool separates(Iterator, std::size_t) {
+    return false;
   }
+};
 
-WAHL_SET_ARG(help);
-WAHL_SET_ARG(metavar);
+// Parses a command of a chain like strict_arguments, and ends the scan at the
+// separator that starts the next command.
+struct chain_arguments : strict_arguments {
+  std::string_view separator;
+  // The number of arguments before the separator. Left unchanged if the scan
+  // did not end at a separator.
+  std::size_t length = 0;
+
+  template <class Iterator> bool separates(Iterator it, std::size_t index) {
+    if (*it != separator)
+      return false;
+    length = index;
+    return true;
+  }
+};
 
-template <class T, class F>
-auto try_parse(rank<1>, T &x, F f) WAHL_RETURNS(x.parse(f));
+// A subcommand of a chain that was parsed, but has not run yet.
+class prepared_command {
+public:
+  virtual ~prepared_command() = default;
 
-template <class T, class F> void try_parse(rank<0>, T &, F) {}
+  // Runs the command, unless parsing ended early, e.g., after `--help`.
+  virtual result run() = 0;
+};
 
-template <class C, class T>
-auto assign_subcommands(rank<1>, C &ctx, T &)
-    -> decltype(T::subcommands, void()) {
-  ctx.subcommands = T::subcommands();
-}
+// A subcommand of a chain that is parsed only when it runs, e.g., because it
+// lives in a plugin that is not loaded yet.
+class deferred_command final : public prepared_command {
+public:
+  explicit deferred_command(std::function<result()> f) : f_(std::move(f)) {}
 
-template <class C, class T> void assign_subcommands(rank<0>, C &, T &) {}
+  result run() override { return f_(); }
 
-template <class... Ts, class T> context<T &, Ts...> build_context(T &cmd) {
-  context<T &, Ts...> ctx;
-  wahl::assign_subcommands(rank<1>{}, ctx, cmd);
-  ctx.parse(
-      nullptr, "-h", "--help", wahl::help("Show help"),
-      wahl::eager_callback([](std::nullptr_t, const auto &c, const argument &) {
-        c.show_help(get_name<T>(), get_help<T>(), get_options_metavar<T>());
-      }));
+private:
+  std::function<result()> f_;
+};
+
+template <class... Args> struct subcommand {
+  std::string help;
+  std::function<result(std::deque<std::string>, Args...)> run;
+  // Creates the command and lists its flags, or null for plugins.
+  flag_help_list (*flags)() = nullptr;
+  // Parses the command for a chain without running it, or null if the
+  // command is parsed when it runs.
+  std::function<error(const std::deque<std::string> &, chain_arguments &,
+                      std::unique_ptr<prepared_command> &, Args...)>
+      prepare;
+};
+
+// A subcommand of a group in compact mode. `run` creates the command, and
+// parses and runs it with the group as its parent.
+struct compact_subcommand {
+  std::string help;
+  result (*run)(const std::deque<std::string> &, void *parent);
+  // Set instead of `run` for subcommands that are implemented by a plugin.
+  std::shared_ptr<const plugin> source;
+  flag_help_list (*flags)() = nullptr;
+  error (*prepare)(const std::deque<std::string> &, chain_arguments &,
+                   void *parent,
+                   std::unique_ptr<prepared_command> &) = nullptr;
+
+  result operator()(const std::deque<std::string> &a, void *parent) const {
+    return source ? source->run(a, parent) : run(a, parent);
+  }
+};
+
+using compact_subcommand_map = std::map<std::string, compact_subcommand>;
+
+enum class constraint_kind { exactly_one, at_most_one, implies, conflicts };
+
+// A constraint over which flags of a command were given. For implies and
+// conflicts, the first flag is the one the constraint is about.
+struct constraint {
+  constraint_kind kind;
+  std::vector<std::string> flags;
+};
+
+// Exactly one of the flags must be given.
+template <class... Flags> constraint exactly_one_of(const Flags &...flags) {
+  static_assert(sizeof...(Flags) >= 2, "a group needs at least two flags");
+  return {constraint_kind::exactly_one, {std::string(flags)...}};
+}
+
+// At most one of the flags may be given.
+template <class... Flags> constraint at_most_one_of(const Flags &...flags) {
+  static_assert(sizeof...(Flags) >= 2, "a group needs at least two flags");
+  return {constraint_kind::at_most_one, {std::string(flags)...}};
+}
+
+// If `flag` is given, all of `others` must be given as well.
+template <class... Flags>
+constraint implies(const std::string &flag, const Flags &...others) {
+  static_assert(sizeof...(Flags) >= 1, "implies needs at least two flags");
+  return {constraint_kind::implies, {flag, std::string(others)...}};
+}
+
+// If `flag` is given, none of `others` may be given.
+template <class... Flags>
+constraint conflicts(const std::string &flag, const Flags &...others) {
+  static_assert(sizeof...(Flags) >= 1, "conflicts needs at least two flags");
+  return {constraint_kind::conflicts, {flag, std::string(others)...}};
+}
+
+// The flags of a constraint, resolved to the indices of their arguments when
+// the context is built.
+struct constraint_mask {
+  // The argument indices of the flags, in the order of the constraint.
+  std::vector<int> indices;
+  // The bits of the flags that are counted, that is, all flags of a group and
+  // all but the first flag otherwise, as the non-zero words of a bitset.
+  std::vector<std::pair<std::size_t, std::uint64_t>> words;
+};
+
+template <class T, class... Args> auto current_name() { return get_name<T>(); }
+
+// The part of a context that does not depend on the type of the command.
+class context_base {
+public:
+  std::vector<argument> arguments;
+  // The dispatch data of the arguments, with the same indices.
+  std::vector<argument_slot> slots;
+  // The index of the argument that captures positional values, or -1.
+  int positional = -1;
+  // The argument indices of the flags, and "" for the positional argument.
+  // The keys view the flags of `arguments`.
+  std::unordered_map<std::string_view, int> lookup;
+  prefix_trie flag_index;
+  std::shared_ptr<const prefix_trie> subcommand_index;
+  std::vector<constraint> constraints;
+  // The masks of the constraints, with the same indices.
+  std::vector<constraint_mask> constraint_masks;
+  // An error in the declarations of the command, which every parse reports.
+  error declaration_error;
+  bool abbreviations = false;
+  // Returns the name of the command, for error messages.
+  std::string (*name)() = nullptr;
+
+  explicit context_base(std::string (*command_name)()) : name(command_name) {}
+
+  // The keys of `lookup` view the flags of `arguments`, which a copy would not
+  // carry over.
+  context_base(const context_base &) = delete;
+  context_base(context_base &&) = default;
+  context_base &operator=(const context_base &) = delete;
+
+  virtual ~context_base() = default;
+
+  virtual bool has_subcommand(const std::string &name) const = 0;
+
+  // The names and help texts of the subcommands.
+  virtual std::vector<std::pair<std::string, std::string>>
+  subcommand_list() const = 0;
+
+  // Enables unique-prefix matching of long flags and subcommand names.
+  void enable_abbreviations();
+
+  error resolve_abbreviation(const prefix_trie &index, std::string &x,
+                             error_code ambiguous) const;
+
+  // Returns the index of the argument for `flag`, resolving abbreviated long
+  // flags, or -1 for unknown and -2 for ambiguous flags. If `flag` is an
+  // abbreviation, `key` receives the flag it stands for.
+  int flag_id(std::string_view flag, std::string_view *key = nullptr) const;
+
+  error ambiguous_flag(std::string_view flag) const;
+
+  // Resolves an abbreviated subcommand name. The name is left empty if `x`
+  // does not name a subcommand.
+  error resolve_subcommand(const std::string &x, std::string &name) const;
+
+  bool has_default_capture() const { return positional >= 0; }
+
+  void add(argument arg);
+
+  void add(constraint c) { constraints.push_back(std::move(c)); }
+
+  argument *find(std::string_view flag);
+
+  error unknown_flag(const std::string &flag) const;
+
+  argument &operator[](const std::string &flag);
+
+  const argument &operator[](const std::string &flag) const;
+
+  void show_help(const std::string &name, const std::string &description,
+                 const std::string &options_metavar) const;
+
+  // Resolves the flags of the constraints to masks once all arguments are
+  // declared. Unknown flags are reported as a declaration error.
+  void resolve_constraints();
+
+  // Checks all constraints in one pass over a bitset of the given arguments,
+  // and reports every violation in a single error.
+  error check_constraints() const;
+
+  error post_process();
+
+  // Set by wahl::each(). Run over the values of their arguments after the
+  // command itself ran.
+  std::vector<std::function<error()>> item_handlers;
+
+  // Runs the item handlers in order, and stops at the first error.
+  error run_item_handlers();
+};
+
+// Lists the flags of the arguments in `ctx`, starting at `first`, with their
+// help texts. Positional arguments are skipped.
+flag_help_list list_flag_help(const context_base &ctx, std::size_t first = 0);
+
+// Adds an argument for `x` with the given flags and attributes to `ctx`,
+// which the attributes receive as their context.
+template <class C, class T, class... Ts>
+void declare_argument(C &ctx, T &&x, Ts &&...xs) {
+  argument arg;
+  arg.write_value = [&x](const std::string &s) { wahl::write_value_to(x, s); };
+  arg.type = wahl::get_argument_type(x);
+  arg.metavar = wahl::type_to_help(x);
+  wahl::each_arg(
+      wahl::overload(
+          [&](const std::string &name) { arg.flags.push_back(name); },
+          [&](auto &&attribute) -> decltype(attribute(x, ctx, arg), void()) {
+            attribute(x, ctx, arg);
+          }),
+      std::forward<Ts>(xs)...);
+  ctx.add(std::move(arg));
+}
+
+// Constraints are declared alongside the arguments, as in
+// `f(wahl::at_most_one_of("--json", "--yaml"))`.
+template <class C> void declare_argument(C &ctx, constraint c) {
+  ctx.add(std::move(c));
+}
+
+template <class... Args> struct context : context_base {
+  using subcommand_type = subcommand<Args...>;
+  using subcommand_map = std::map<std::string, subcommand_type>;
+  subcommand_map subcommands;
+  // The subcommands of a group in compact mode.
+  const compact_subcommand_map *compact_subcommands = nullptr;
+
+  context() : context_base(&command_name) {}
+
+  static std::string command_name() { return current_name<Args...>(); }
+
+  bool has_subcommand(const std::string &name) const override {
+    if (name == current_name<Args...>())
+      return false;
+    if (compact_subcommands != nullptr)
+      return compact_subcommands->count(name) > 0;
+    return subcommands.find(name) != subcommands.end();
+  }
+
+  std::vector<std::pair<std::string, std::string>>
+  subcommand_list() const override {
+    std::vector<std::pair<std::string, std::string>> result;
+    if (compact_subcommands != nullptr)
+      for (auto &&p : *compact_subcommands)
+        result.emplace_back(p.first, p.second.help);
+    for (auto &&p : subcommands)
+      result.emplace_back(p.first, p.second.help);
+    return result;
+  }
+
+  template <class T, class... Ts> void parse(T &&x, Ts &&...xs) {
+#if WAHL_COMPACT
+    // Attributes see the context base only, so that their code is shared
+    // between all commands.
+    wahl::declare_argument(static_cast<context_base &>(*this),
+                           std::forward<T>(x), std::forward<Ts>(xs)...);
+#else
+    wahl::declare_argument(*this, std::forward<T>(x), std::forward<Ts>(xs)...);
+#endif
+  }
+};
+
+template <class F> auto callback(F f) {
+  return [f](auto &&data, auto &ctx, argument &a) {
+    a.add_callback(
+        [f, &ctx, &data](const argument &arg) { f(data, ctx, arg); });
+  };
+}
+
+template <class F> auto eager_callback(F f) {
+  return [f](auto &&data, auto &ctx, argument &a) {
+    a.add_eager_callback(
+        [f, &data, &ctx](const argument &arg) { f(data, ctx, arg); });
+  };
+}
+
+template <class F> auto lazy_callback(F f) {
+  return [f](auto &&data, auto &ctx, argument &a) {
+    a.add_callback([f, &ctx, &data](const argument &arg) {
+      if (arg.count > 0)
+        f(data, ctx, arg);
+    });
+  };
+}
+
+template <class F> auto action(F f) {
+  return wahl::eager_callback(std::bind(f));
+}
+
+template <class T> auto show(T text) {
+  return action([line = std::string(text)] { wahl::print_line(line); });
+}
+
+inline auto required() {
+  return [](auto &&, auto &, argument &a) {
+    a.required = true;
+    a.add_callback([](const argument &arg) {
+      if (arg.required and arg.count == 0)
+        wahl::fail({error_code::missing_required, {}, arg.get_flags()});
+    });
+  };
+}
+
+template <class T> auto set(T value) {
+  return [value](auto &&data, auto &, argument &a) {
+    a.type = argument_type::none;
+    a.write_value = [&data, value](const std::string &) { data = value; };
+  };
+}
+
+inline auto count() {
+  return [](auto &&data, auto &, argument &a) {
+    a.type = argument_type::none;
+    a.add_callback([&data](const argument &arg) { data = arg.count; });
+    a.write_value = [](const std::string &) {};
+  };
+}
+
+// Identifies the default_from providers of type F.
+template <class F> struct default_tag {
+  static constexpr char id = 0;
+};
+
+// Returns the default of the provider tagged `tag` on the argument with index
+// `index` of the command that `name` names. The name function is unique to
+// the command type, so the cache outlives the attribute, which parse()
+// typically creates anew on every parse. `compute` runs once per key, also
+// across threads.
+const std::shared_ptr<const void> &
+cached_default(const void *tag, std::string (*name)(), std::size_t index,
+               const std::function<std::shared_ptr<const void>()> &compute);
+
+// Assigns the result of `f` to the argument after the scan if the argument
+// was not given, so that expensive defaults like probing the hardware are
+// skipped when the user overrides them. The result is cached per command type
+// and argument, and reused by later parses. The help shows `description`
+// instead of evaluating `f`.
+template <class F>
+auto default_from(F f, std::string description = "computed") {
+  using value_type = std::decay_t<decltype(f())>;
+  return [f, description](auto &&data, auto &ctx, argument &a) {
+    a.default_description = description;
+    auto name = ctx.name;
+    auto index = ctx.arguments.size();
+    a.add_callback([f, name, index, &data](const argument &arg) {
+      if (arg.count != 0)
+        return;
+      auto compute = [&] {
+        return std::shared_ptr<const void>(std::make_shared<value_type>(f()));
+      };
+      auto &value =
+          wahl::cached_default(&default_tag<F>::id, name, index, compute);
+      data = *static_cast<const value_type *>(value.get());
+    });
+  };
+}
+
+// Treats the value of the flag as a file (or "-" for standard input) with one
+// value per line, and streams the converted values into the container.
+inline auto values_from_file() {
+  return [](auto &&data, auto &, argument &a) {
+    static_assert(is_container<std::decay_t<decltype(data)>>() and
+                      not std::is_convertible<decltype(data), std::string>(),
+                  "values_from_file requires a container argument");
+    a.type = argument_type::single;
+    a.metavar = "[file]";
+    a.write_value = [&data](const std::string &path) {
+      wahl::read_values_from(path, data);
+    };
+  };
+}
+
+// Collects the values of a container argument while scanning and converts
+// them afterwards in parallel chunks of at least `grain` values, which pays
+// off for arguments that receive a very large number of values.
+inline auto parallel(std::size_t grain = 16384) {
+  return [grain](auto &&data, auto &, argument &a) {
+    static_assert(is_container<std::decay_t<decltype(data)>>() and
+                      not std::is_convertible<decltype(data), std::string>(),
+                  "parallel requires a container argument");
+    a.write_values = [&data, grain](const auto &tokens) {
+      return wahl::convert_values(tokens, data, grain);
+    };
+  };
+}
+
+// Controls how wahl::each() runs a handler over the items of an argument.
+struct execution {
+  // The number of threads, including the calling one. 0 uses one thread per
+  // hardware thread, and 1 runs the items one after another.
+  unsigned jobs = 0;
+  // Prints outputs in the order of the items rather than as they complete.
+  bool ordered = true;
+};
+
+// Calls `task` with every index in [0, n) on a work-stealing pool of
+// `exec.jobs` threads. Every thread starts with a slice of the indices and
+// steals half of the largest remaining slice once its own is done. `task`
+// returns true if it stored a line of output. After the first error reported
+// with wahl::fail, no further items start, and the error of the first failed
+// item is returned.
+error for_each_item(std::size_t n, const execution &exec,
+                    bool (*task)(void *f, std::size_t i, std::string &output),
+                    void *f);
+
+template <class Container, class F>
+error run_each(const Container &items, F &f, const execution &exec) {
+  using value_type = typename Container::value_type;
+  std::vector<const value_type *> pointers;
+  pointers.reserve(items.size());
+  for (auto &&x : items)
+    pointers.push_back(&x);
+  auto call = [&](std::size_t i, std::string &output) {
+    using output_type = decltype(f(*pointers[i]));
+    if constexpr (std::is_void<output_type>()) {
+      f(*pointers[i]);
+      return false;
+    } else {
+      output = f(*pointers[i]);
+      return true;
+    }
+  };
+  return wahl::for_each_item(
+      pointers.size(), exec,
+      [](void *p, std::size_t i, std::string &output) {
+        return (*static_cast<decltype(call) *>(p))(i, output);
+      },
+      &call);
+}
+
+// Runs `f` for every value of a container argument, typically the positional
+// one, after the command ran. The items run concurrently as configured by
+// `exec`, which is read when the items run, so its fields may be bound to
+// flags like `-j`. If `f` returns a string, it is printed as a line. Errors
+// that `f` reports with wahl::fail cancel the items that have not started.
+template <class F> auto each(F f, const execution &exec) {
+  return [f, &exec](auto &&data, auto &ctx, argument &) {
+    static_assert(is_container<std::decay_t<decltype(data)>>() and
+                      not std::is_convertible<decltype(data), std::string>(),
+                  "each requires a container argument");
+    ctx.item_handlers.push_back(
+        [f, &exec, &data]() mutable { return wahl::run_each(data, f, exec); });
+  };
+}
+
+template <class F> auto each(F f) {
+  static const execution defaults;
+  return wahl::each(std::move(f), defaults);
+}
+
+enum class path_check { existing_file, existing_dir, readable, writable_dir };
+
+// Checks the paths concurrently on a bounded thread pool, and reports every
+// path that fails the check in one error, in the order of the paths.
+error check_paths(path_check check, const std::vector<std::string> &paths,
+                  const std::string &flags);
+
+// Validates all values of a path argument in one batch after the scan. The
+// argument may be a single path or a container of paths.
+inline auto validate_paths(path_check check) {
+  return [check](auto &&data, auto &, argument &a) {
+    a.add_callback([check, &data](const argument &arg) {
+      if (arg.count == 0)
+        return;
+      std::vector<std::string> paths;
+      if constexpr (is_container<std::decay_t<decltype(data)>>() and
+                    not std::is_convertible<decltype(data), std::string>())
+        for (auto &&x : data)
+          paths.emplace_back(x);
+      else
+        paths.emplace_back(data);
+      if (auto e = wahl::check_paths(check, paths, arg.get_flags()))
+        wahl::fail(std::move(e));
+    });
+  };
+}
+
+// Requires every value to name an existing file that is not a directory.
+inline auto existing_file() {
+  return wahl::validate_paths(path_check::existing_file);
+}
+
+// Requires every value to name an existing directory.
+inline auto existing_dir() {
+  return wahl::validate_paths(path_check::existing_dir);
+}
+
+// Requires every value to name something the process can read.
+inline auto readable() { return wahl::validate_paths(path_check::readable); }
+
+// Requires every value to name a directory the process can write to.
+inline auto writable_dir() {
+  return wahl::validate_paths(path_check::writable_dir);
+}
+
+#define WAHL_SET_ARG(name)                                                     \
+  template <class T> auto name(T &&x) {                                        \
+    return [=](auto &&, auto &, argument &a) { a.name = x; };                  \
+  }
+
+WAHL_SET_ARG(help);
+WAHL_SET_ARG(metavar);
+
+template <class T, class F>
+auto try_parse(rank<1>, T &x, F f) WAHL_RETURNS(x.parse(f));
+
+template <class T, class F> void try_parse(rank<0>, T &, F) {}
+
+template <class C, class T>
+auto assign_subcommands(rank<1>, C &ctx, T &)
+    -> decltype(ctx.subcommands = T::subcommands(), void()) {
+  ctx.subcommands = T::subcommands();
+}
+
+template <class... Args, class T>
+auto assign_subcommands(rank<2>, context<Args...> &ctx, T &)
+    -> decltype(ctx.compact_subcommands = &T::subcommands(), void()) {
+  ctx.compact_subcommands = &T::subcommands();
+}
+
+template <class C, class T> void assign_subcommands(rank<0>, C &, T &) {}
+
+template <class C, class T>
+auto assign_subcommand_index(rank<1>, C &ctx, T &)
+    -> decltype(T::subcommand_index(), void()) {
+  ctx.subcommand_index = T::subcommand_index();
+}
+
+template <class C, class T> void assign_subcommand_index(rank<0>, C &, T &) {}
+
+template <class... Ts, class T> context<T &, Ts...> build_context(T &cmd) {
+  phase_scope scope{parse_phase::context_build};
+  context<T &, Ts...> ctx;
+  wahl::assign_subcommands(rank<2>{}, ctx, cmd);
+  ctx.parse(
+      nullptr, "-h", "--help", wahl::help("Show help"),
+      wahl::eager_callback([](std::nullptr_t, const auto &c, const argument &) {
+        c.show_help(get_name<T>(), get_help<T>(), get_options_metavar<T>());
+      }));
   wahl::try_parse(rank<1>{}, cmd, [&](auto &&...xs) {
     ctx.parse(std::forward<decltype(xs)>(xs)...);
   });
+  ctx.resolve_constraints();
+  if (get_abbreviations<T>()) {
+    wahl::assign_subcommand_index(rank<1>{}, ctx, cmd);
+    ctx.enable_abbreviations();
+  }
   return ctx;
 }
 
-template <class Iterator>
-std::string pop_string(Iterator first, Iterator last) {
-  if (first == last)
-    return std::string();
-  else
-    return std::string(first + 1, last);
-}
-
-inline std::tuple<std::string, std::string>
-parse_attached_value(const std::string &s) {
-  assert(s.size() > 0);
-  assert(s[0] == '-' && "Not parsing a flag");
-  if (s[1] == '-') {
-    auto it = std::find(s.begin(), s.end(), '=');
-    return std::make_tuple(std::string(s.begin(), it),
-                           wahl::pop_string(it, s.end()));
-  } else if (s.size() > 2) {
-    return std::make_tuple(s.substr(0, 2), s.substr(2));
+// Splits a flag from a value attached to it, as in "--flag=value" or "-fvalue".
+std::tuple<std::string, std::string>
+parse_attached_value(const std::string &s);
+
+template <class T, class... Ts>
+auto try_run(rank<2>, T &x, Ts &&...xs) WAHL_RETURNS(x.run(xs...));
+
+template <class T, class... Ts>
+auto try_run(rank<1>, T &x, Ts &&...) WAHL_RETURNS(x.run());
+
+// The arguments being scanned, independent of how the caller stores them.
+class token_list {
+public:
+  virtual ~token_list() = default;
+
+  virtual std::size_t size() const = 0;
+
+  // Returns the token at `i`, copying it into `buffer` if the caller does not
+  // store it as a string.
+  virtual const std::string &get(std::size_t i, std::string &buffer) const = 0;
+
+  virtual std::string_view view(std::size_t i) const = 0;
+};
+
+template <class Iterator> class iterator_tokens final : public token_list {
+public:
+  iterator_tokens(Iterator first, Iterator last)
+      : first_(first), size_(std::distance(first, last)) {}
+
+  std::size_t size() const override { return size_; }
+
+  const std::string &get(std::size_t i, std::string &buffer) const override {
+    if constexpr (std::is_same<std::decay_t<decltype(*first_)>,
+                               std::string>{}) {
+      return *std::next(first_, i);
+    } else {
+      buffer.assign(*std::next(first_, i));
+      return buffer;
+    }
+  }
+
+  std::string_view view(std::size_t i) const override {
+    return *std::next(first_, i);
+  }
+
+private:
+  Iterator first_;
+  std::size_t size_;
+};
+
+// Checks the number and length of the tokens against the active limits, and
+// charges the token stream against the memory budget.
+error check_limits(const token_list &tokens);
+
+// Decides what happens to the tokens that a context does not handle itself.
+class scan_handler {
+public:
+  virtual ~scan_handler() = default;
+
+  // Returns true to skip the unknown token at `index` instead of failing.
+  virtual bool unknown(std::size_t index) = 0;
+
+  // Returns true if the `--` at `index` ends the scan.
+  virtual bool terminate(std::size_t index) = 0;
+
+  // Runs the subcommand `name` on the tokens after `index`.
+  virtual error dispatch(const std::string &name, std::size_t index) = 0;
+
+  // Returns true if the value at `index` separates the commands of a chain,
+  // which ends the scan. Only values that are not the value of a flag and
+  // that precede any `--` are checked.
+  virtual bool separates(std::size_t) { return false; }
+};
+
+template <class Iterator, class Policy, class Dispatch>
+class policy_handler final : public scan_handler {
+public:
+  policy_handler(Iterator first, Policy &policy, Dispatch dispatch)
+      : first_(first), policy_(policy), dispatch_(std::move(dispatch)) {}
+
+  bool unknown(std::size_t index) override {
+    return policy_.unknown(std::next(first_, index));
+  }
+
+  bool terminate(std::size_t index) override {
+    return policy_.terminate(std::next(first_, index));
+  }
+
+  error dispatch(const std::string &name, std::size_t index) override {
+    return dispatch_(name, index);
+  }
+
+  bool separates(std::size_t index) override {
+    return policy_.separates(std::next(first_, index), index);
+  }
+
+private:
+  Iterator first_;
+  Policy &policy_;
+  Dispatch dispatch_;
+};
+
+// How the tokenizer classified an argument.
+enum class token_kind : std::uint8_t {
+  value,      // A value or a positional argument.
+  flag,       // A flag of the context, possibly with an attached value.
+  bundled,    // A short flag bundled into the previous flag, as in "-vq".
+  unknown,    // A flag that the context does not know.
+  ambiguous,  // An abbreviation of several long flags.
+  terminator, // The "--" that ends option parsing.
+  subcommand, // The name of a subcommand, which ends the scan.
+};
+
+// A classified argument. The views point into the scanned arguments, or into
+// the context for abbreviated flags.
+struct token {
+  token_kind kind;
+  // The argument of a flag in the context, or -1.
+  int argument;
+  // The position of the argument in the scanned arguments.
+  std::size_t index;
+  // The flag without its value, or the whole argument. Bundled flags are
+  // their single character, and abbreviations the flag they stand for.
+  std::string_view text;
+  // The value attached to a flag, as in "--name=value" or "-nvalue".
+  std::string_view value;
+};
+
+// Classifies the arguments for the context in one pass, without allocating
+// per argument. Classification stops after a subcommand, and all arguments
+// after a terminator are values. The tokens can be reused for completion or
+// tracing.
+void tokenize(const context_base &ctx, const token_list &tokens,
+              std::vector<token> &result);
+
+// Scans the tokens into the context. Sets `completed` to false if an eager
+// callback or a subcommand ended the parse early.
+error scan_arguments(context_base &ctx, const token_list &tokens,
+                     scan_handler &handler, bool &completed);
+
+// Scans the arguments in [first, last) into the context of `cmd`, and
+// dispatches to its subcommands.
+template <class C, class T, class Iterator, class Policy, class... Ts>
+error parse_arguments(C &ctx, T &cmd, Iterator first, Iterator last,
+                      Policy &policy, bool &completed, Ts &&...xs) {
+  iterator_tokens<Iterator> tokens(first, last);
+  auto dispatch = [&](const std::string &name, std::size_t index) {
+    auto rest = std::deque<std::string>(std::next(first, index + 1), last);
+    auto e =
+        ctx.compact_subcommands != nullptr
+            ? ctx.compact_subcommands->at(name)(rest, &cmd).error()
+            : ctx.subcommands[name].run(std::move(rest), cmd, xs...).error();
+    return e.shift(int(index) + 1);
+  };
+  policy_handler<Iterator, Policy, decltype(dispatch)> handler(first, policy,
+                                                               dispatch);
+  return wahl::scan_arguments(ctx, tokens, handler, completed);
+}
+
+// Builds the context for a command, parses [first, last) into it, and runs
+// the command unless parsing ended early.
+template <class T, class Iterator, class Policy, class... Ts>
+result parse_range(T &cmd, Iterator first, Iterator last, Policy &policy,
+                   Ts &&...xs) {
+  auto ctx = wahl::build_context<Ts...>(cmd);
+  bool completed = false;
+  if (auto e = wahl::parse_arguments(ctx, cmd, first, last, policy, completed,
+                                     xs...))
+    return e;
+  if (not completed)
+    return {};
+  if (auto e = ctx.post_process())
+    return e;
+
+  phase_scope running{parse_phase::none};
+  wahl::try_run(rank<2>{}, cmd, xs...);
+  return ctx.run_item_handlers();
+}
+
+// A subcommand of group `Parent` that is parsed into its own storage, and run
+// later like parse_range would have run it.
+template <class T, class Parent>
+class prepared_invocation final : public prepared_command {
+public:
+  explicit prepared_invocation(Parent &parent)
+      : parent_(parent), ctx_(wahl::build_context<Parent &>(cmd_)) {}
+
+  error parse(const std::deque<std::string> &a, chain_arguments &policy) {
+    if (auto e = wahl::parse_arguments(ctx_, cmd_, a.begin(), a.end(), policy,
+                                       completed_, parent_))
+      return e;
+    return completed_ ? ctx_.post_process() : error{};
+  }
+
+  result run() override {
+    if (not completed_)
+      return {};
+    phase_scope running{parse_phase::none};
+    wahl::try_run(rank<2>{}, cmd_, parent_);
+    return ctx_.run_item_handlers();
+  }
+
+private:
+  Parent &parent_;
+  T cmd_ = {};
+  context<T &, Parent &> ctx_;
+  bool completed_ = false;
+};
+
+// Describes a command to the compact parse engine. The descriptor of a
+// command is the only code that compact mode generates for it.
+struct command_descriptor {
+  std::string (*name)();
+  std::string (*help)();
+  std::string (*options_metavar)();
+  bool abbreviations;
+  // Returns the subcommands of a group, or null.
+  const compact_subcommand_map *(*subcommands)();
+  // Declares the arguments of the command in the context.
+  void (*declare)(void *cmd, context_base &ctx);
+  // Runs the command with its parent, which is null for top-level commands.
+  void (*run)(void *cmd, void *parent);
+};
+
+// Parses the arguments into a described command and runs it.
+result parse_compact(const command_descriptor &d, void *cmd,
+                     const std::deque<std::string> &a, void *parent);
+
+// Parses the arguments into a described command that `cmd` owns, and stores
+// it in `out` to run later with its parent.
+error prepare_compact(const command_descriptor &d, std::shared_ptr<void> cmd,
+                      const std::deque<std::string> &a,
+                      chain_arguments &policy, void *parent,
+                      std::unique_ptr<prepared_command> &out);
+
+// Lists the flags that the described command declares for `cmd`.
+flag_help_list compact_flag_help(const command_descriptor &d, void *cmd);
+
+template <class T>
+auto compact_subcommands_of(rank<1>)
+    -> decltype(static_cast<const compact_subcommand_map *>(
+        &T::subcommands())) {
+  return &T::subcommands();
+}
+
+template <class T>
+const compact_subcommand_map *compact_subcommands_of(rank<0>) {
+  return nullptr;
+}
+
+// Returns the descriptor of command `T` with the parent types `Ps`.
+template <class T, class... Ps> const command_descriptor &describe() {
+  static_assert(sizeof...(Ps) <= 1,
+                "compact commands take at most one parent");
+  static const command_descriptor descriptor = {
+      [] { return std::string(get_name<T>()); },
+      [] { return std::string(get_help<T>()); },
+      [] { return std::string(get_options_metavar<T>()); },
+      get_abbreviations<T>(),
+      [] { return wahl::compact_subcommands_of<T>(rank<1>{}); },
+      [](void *cmd, context_base &ctx) {
+        auto &x = *static_cast<T *>(cmd);
+        wahl::try_parse(rank<1>{}, x, [&](auto &&...xs) {
+          wahl::declare_argument(ctx, std::forward<decltype(xs)>(xs)...);
+        });
+        wahl::assign_subcommand_index(rank<1>{}, ctx, x);
+      },
+      [](void *cmd, void *parent) {
+        (void)parent;
+        wahl::try_run(rank<2>{}, *static_cast<T *>(cmd),
+                      *static_cast<Ps *>(parent)...);
+      },
+  };
+  return descriptor;
+}
+
+inline void *parent_pointer() { return nullptr; }
+
+template <class P> void *parent_pointer(P &parent) {
+  return const_cast<void *>(static_cast<const void *>(std::addressof(parent)));
+}
+
+// Parses the arguments into the command and runs it. Errors are returned
+// instead of thrown, and are not printed.
+template <class T, class... Ts>
+result parse(std::nothrow_t, T &cmd, const std::deque<std::string> &a,
+             Ts &&...xs) {
+#if WAHL_COMPACT
+  return wahl::parse_compact(
+      wahl::describe<T, std::remove_reference_t<Ts>...>(), &cmd, a,
+      wahl::parent_pointer(xs...));
+#else
+  strict_arguments policy;
+  return wahl::parse_range(cmd, a.begin(), a.end(), policy, xs...);
+#endif
+}
+
+template <class T, class... Ts>
+void parse(T &cmd, std::deque<std::string> a, Ts &&...xs) {
+  if (auto r = wahl::parse(std::nothrow, cmd, a, xs...); not r)
+    wahl::raise(r.error());
+}
+
+// Parses the arguments into the command without running it. If `counts` is
+// not null, it receives how often each argument was given, in the order in
+// which the command declares its arguments.
+template <class T>
+result parse_only(std::nothrow_t, T &cmd, const std::deque<std::string> &a,
+                  std::vector<int> *counts = nullptr) {
+  auto ctx = wahl::build_context(cmd);
+  strict_arguments policy;
+  bool completed = false;
+  if (auto e = wahl::parse_arguments(ctx, cmd, a.begin(), a.end(), policy,
+                                     completed))
+    return e;
+  if (completed)
+    if (auto e = ctx.post_process())
+      return e;
+  if (counts != nullptr) {
+    // The first argument is the implicit help flag.
+    counts->clear();
+    for (auto it = std::next(ctx.arguments.begin());
+         it != ctx.arguments.end(); ++it)
+      counts->push_back(it->count);
+  }
+  return {};
+}
+
+template <class T>
+void parse_only(T &cmd, const std::deque<std::string> &a,
+                std::vector<int> *counts = nullptr) {
+  if (auto r = wahl::parse_only(std::nothrow, cmd, a, counts); not r)
+    wahl::raise(r.error());
+}
+
+// Tracks the readers of RCU-style snapshots. Readers enter and leave without
+// waiting, and `exchange` returns a replaced snapshot only after every reader
+// that could still see it has left.
+class reader_epochs {
+public:
+  unsigned enter() const noexcept {
+    auto epoch = epoch_.load() & 1u;
+    readers_[epoch].count.fetch_add(1);
+    return epoch;
+  }
+
+  void leave(unsigned epoch) const noexcept {
+    readers_[epoch].count.fetch_sub(1, std::memory_order_release);
+  }
+
+  // Publishes `next` as the current snapshot, and returns the previous one
+  // once it can be destroyed. Writers are serialized.
+  const void *exchange(std::atomic<const void *> &current, const void *next);
+
+private:
+  // Each counter has a cache line of its own, so that readers of one epoch
+  // do not slow down the writer waiting for the other.
+  struct alignas(64) counter {
+    mutable std::atomic<std::size_t> count{0};
+  };
+
+  std::atomic<unsigned> epoch_{0};
+  counter readers_[2];
+};
+
+// Holds a command as reloadable configuration, e.g., of a daemon that
+// re-parses its arguments on SIGHUP. Readers take wait-free references to
+// an immutable snapshot, while `reload` parses into a fresh command and
+// publishes it RCU-style. A reload waits until readers of the previous
+// snapshot are done, so readers should not hold references for long, and a
+// thread must not reload while it holds one.
+template <class T> class live {
+public:
+  // A reference to a published snapshot, which stays valid while it lives.
+  class snapshot {
+  public:
+    snapshot(snapshot &&other) noexcept
+        : epochs_(std::exchange(other.epochs_, nullptr)),
+          epoch_(other.epoch_),
+          value_(other.value_) {}
+
+    snapshot &operator=(snapshot &&) = delete;
+
+    ~snapshot() {
+      if (epochs_ != nullptr)
+        epochs_->leave(epoch_);
+    }
+
+    const T &operator*() const { return *value_; }
+
+    const T *operator->() const { return value_; }
+
+  private:
+    friend class live;
+
+    explicit snapshot(const reader_epochs &epochs)
+        : epochs_(&epochs), epoch_(epochs.enter()) {}
+
+    const reader_epochs *epochs_;
+    unsigned epoch_;
+    const T *value_ = nullptr;
+  };
+
+  explicit live(T initial = {}) : current_(new T(std::move(initial))) {}
+
+  live(const live &) = delete;
+  live &operator=(const live &) = delete;
+
+  ~live() { delete static_cast<const T *>(current_.load()); }
+
+  snapshot get() const noexcept {
+    snapshot result(epochs_);
+    result.value_ = static_cast<const T *>(current_.load());
+    return result;
+  }
+
+  // Publishes `value`, and destroys the previous snapshot once its readers
+  // are done.
+  void publish(T value) {
+    auto next = new T(std::move(value));
+    delete static_cast<const T *>(epochs_.exchange(current_, next));
+  }
+
+  // Parses the arguments into a fresh command without running it, and
+  // publishes it if parsing and the command's constraints succeed. On
+  // failure, readers keep seeing the current snapshot.
+  result reload(const std::deque<std::string> &a) {
+    T fresh = {};
+    if (auto r = wahl::parse_only(std::nothrow, fresh, a); not r)
+      return r;
+    publish(std::move(fresh));
+    return {};
+  }
+
+private:
+  reader_epochs epochs_;
+  std::atomic<const void *> current_;
+};
+
+// Appends the arguments in the file at `path` to `result`, one per line,
+// e.g., to reload a configuration from the command line and a file. Blank
+// lines and lines starting with '#' are skipped.
+error read_arguments(const std::string &path, std::deque<std::string> &result);
+
+// Which expansions split_arguments applies to the unquoted parts of words.
+struct expansion {
+  // Expands `shard-{a,b}` to `shard-a shard-b`, and `{0..63}`, `{00..63}`,
+  // `{0..63..4}`, or `{a..f}` to sequences.
+  bool braces = true;
+  // Replaces words with `*`, `?`, or `[...]` by the paths they match, in
+  // order. Words without matches are kept as they are.
+  bool globs = true;
+  // The most arguments that a line may expand to, or 0 for no limit, so that
+  // a short line like `{1..1000000000}` cannot exhaust memory.
+  std::size_t max_arguments = 65536;
+};
+
+// Splits a command line into arguments like a POSIX shell, with single and
+// double quotes and backslash escapes, and expands braces and then globs in
+// the parts of words that are not quoted. Calls `f` with every argument as
+// it is produced, until it returns false, so that expansions are never
+// collected. Every directory is read once per call, however many patterns
+// start in it. The active limits bound the number and bytes of arguments.
+error split_arguments(std::string_view line,
+                      const std::function<bool(const std::string &)> &f,
+                      const expansion &options = {});
+
+// Appends the arguments of `line` to `result`, and charges each of them
+// against the memory budget of the active limits as it is appended.
+error split_arguments(std::string_view line, std::deque<std::string> &result,
+                      const expansion &options = {});
+
+// A view over a range of an argument vector.
+class argv_view {
+public:
+  argv_view() = default;
+
+  argv_view(char const **first, char const **last)
+      : first_(first), last_(last) {}
+
+  char const **begin() const { return first_; }
+  char const **end() const { return last_; }
+  char const **data() const { return first_; }
+  std::size_t size() const { return last_ - first_; }
+  bool empty() const { return first_ == last_; }
+  char const *operator[](std::size_t i) const { return first_[i]; }
+
+private:
+  char const **first_ = nullptr;
+  char const **last_ = nullptr;
+};
+
+// The arguments that parse_known did not consume. All views point into the
+// original argument vector, which parse_known reorders in place: consumed
+// arguments come first, followed by the unknown arguments, the `--`
+// terminator, and the arguments after it.
+struct known_arguments {
+  // Arguments that were not recognized, in their original order.
+  argv_view unknown;
+  // Arguments after the `--` terminator. Like argv, the view is terminated by
+  // a null pointer, so `rest.data()` may be passed to execv directly.
+  argv_view rest;
+  // The unknown arguments followed by `--` and the remainder, if present. The
+  // view is terminated by a null pointer as well.
+  argv_view forward;
+  bool terminated = false;
+  // The consumed slot in front of `forward`, which holds at least the program
+  // name. Null if `argc` was 0.
+  char const **slot = nullptr;
+
+  // Places `argv0` in the consumed slot in front of `forward` and returns an
+  // argument vector for execv or posix_spawn that forwards all unconsumed
+  // arguments to a child process. Returns null if there is no slot.
+  char const **exec_argv(char const *argv0) const {
+    if (slot == nullptr)
+      return nullptr;
+    *slot = argv0;
+    return slot;
+  }
+};
+
+// Collects unknown arguments instead of rejecting them, and stops at the
+// first `--` terminator.
+struct known_arguments_policy {
+  // The slots of the unknown arguments and their values.
+  std::vector<std::pair<char const **, char const *>> unknown_arguments;
+  char const **terminator = nullptr;
+
+  bool unknown(char const **it) {
+    unknown_arguments.emplace_back(it, *it);
+    return true;
+  }
+
+  bool terminate(char const **it) {
+    terminator = it;
+    return true;
+  }
+
+  bool separates(char const **, std::size_t) { return false; }
+};
+
+// Parses the arguments that the command knows, and returns the rest as views
+// into `argv` without copying them, e.g., for a wrapper that forwards them to
+// another program. `argv[argc]` must be a null pointer, as it is for the
+// arguments of `main`. Subcommands parse their arguments strictly.
+template <class T, class... Ts>
+result parse_known(std::nothrow_t, T &cmd, int argc, char const *argv[],
+                   known_arguments &known, Ts &&...xs) {
+  known_arguments_policy policy;
+  auto first = argv + std::min(argc, 1);
+  auto last = argv + argc;
+  auto r = wahl::parse_range(cmd, first, last, policy, xs...);
+
+  // Move the unknown arguments in front of the terminator, keeping the
+  // relative order of both the consumed and the unknown arguments.
+  auto terminator = policy.terminator ? policy.terminator : last;
+  auto out = first;
+  auto next = policy.unknown_arguments.begin();
+  for (auto it = first; it != terminator; ++it) {
+    if (next != policy.unknown_arguments.end() and next->first == it)
+      ++next;
+    else
+      *out++ = *it;
+  }
+  for (auto &&x : policy.unknown_arguments)
+    *out++ = x.second;
+  out -= policy.unknown_arguments.size();
+
+  known.unknown = {out, terminator};
+  known.terminated = policy.terminator != nullptr;
+  known.rest = {known.terminated ? terminator + 1 : last, last};
+  known.forward = {out, last};
+  known.slot = out != argv ? out - 1 : nullptr;
+  return r;
+}
+
+template <class T, class... Ts>
+known_arguments parse_known(T &cmd, int argc, char const *argv[],
+                            Ts &&...xs) {
+  known_arguments known;
+  if (auto r = wahl::parse_known(std::nothrow, cmd, argc, argv, known, xs...);
+      not r)
+    wahl::raise(r.error());
+  return known;
+}
+
+// Parses untrusted arguments into the command within the limits `l`, as if
+// parsing inside a limit_scope.
+template <class T, class... Ts>
+result parse_bounded(std::nothrow_t, T &cmd, const std::deque<std::string> &a,
+                     const limits &l, Ts &&...xs) {
+  limit_scope scope(l);
+  return wahl::parse(std::nothrow, cmd, a, xs...);
+}
+
+// Parses a command line that did not come through a shell, such as a line of
+// a batch file or a request on a socket, after splitting and expanding it
+// with split_arguments. The scan needs random access to the arguments, so
+// they are collected before parsing rather than streamed into it. Collecting
+// stops at `options.max_arguments` arguments, and at the active limits on
+// tokens, bytes, and memory, which are checked for every argument as the
+// expansion produces it.
+template <class T, class... Ts>
+result parse_line(std::nothrow_t, T &cmd, std::string_view line,
+                  const expansion &options, Ts &&...xs) {
+  std::deque<std::string> a;
+  if (auto e = wahl::split_arguments(line, a, options))
+    return e;
+  return wahl::parse(std::nothrow, cmd, a, xs...);
+}
+
+template <class T, class... Ts>
+result parse(std::nothrow_t, const std::deque<std::string> &a, Ts &&...xs) {
+  T cmd = {};
+
+  return wahl::parse(std::nothrow, cmd, a, xs...);
+}
+
+template <class T, class... Ts>
+void parse(std::deque<std::string> a, Ts &&...xs) {
+  T cmd = {};
+
+  wahl::parse(cmd, std::move(a), xs...);
+}
+
+// Runs `f`, which returns a result, and prints its error, or the message of
+// an exception escaping from `f`, to stderr.
+template <class F> bool report_errors(F f) {
+#if WAHL_EXCEPTIONS
+  try {
+#endif
+    if (auto r = f(); not r) {
+      wahl::print_error(r.error().message());
+      return false;
+    }
+#if WAHL_EXCEPTIONS
+  } catch (const std::exception &ex) {
+    wahl::print_error(ex.what());
+    return false;
+  }
+#endif
+  return true;
+}
+
+template <class T> bool parse(int argc, char const *argv[]) {
+  phase_scope scope{parse_phase::tokenization};
+  std::deque<std::string> as(argv + 1, argv + argc);
+
+  return wahl::report_errors([&] { return wahl::parse<T>(std::nothrow, as); });
+}
+
+// Returns the file name of `argv0` without its directory and, on Windows,
+// without an ".exe" suffix.
+std::string_view program_name(const char *argv0);
+
+// Parses the arguments of a multi-call binary, busybox-style, into the group
+// `cmd`. If the program name in `argv[0]` names a subcommand, that subcommand
+// runs with all arguments, and otherwise the arguments are parsed as usual.
+// The group's own arguments keep their defaults when dispatching on the
+// program name.
+template <class T>
+result parse_multicall(std::nothrow_t, T &cmd, int argc, char const *argv[]) {
+  phase_scope scope{parse_phase::tokenization};
+  std::deque<std::string> a(argv + std::min(argc, 1), argv + argc);
+  if (argc > 0) {
+    auto &subcommands = T::subcommands();
+    auto it = subcommands.find(std::string(wahl::program_name(argv[0])));
+    if (it != subcommands.end()) {
+#if WAHL_COMPACT
+      return it->second(a, &cmd);
+#else
+      return it->second.run(std::move(a), cmd);
+#endif
+    }
+  }
+  return wahl::parse(std::nothrow, cmd, a);
+}
+
+template <class T> bool parse_multicall(int argc, char const *argv[]) {
+  T cmd = {};
+
+  return wahl::report_errors(
+      [&] { return wahl::parse_multicall(std::nothrow, cmd, argc, argv); });
+}
+
+// Scans the flags of a group up to its first subcommand, and records the
+// subcommand instead of running it.
+class chain_start final : public scan_handler {
+public:
+  bool unknown(std::size_t) override { return false; }
+
+  bool terminate(std::size_t) override { return false; }
+
+  error dispatch(const std::string &name, std::size_t index) override {
+    name_ = name;
+    index_ = index;
+    return {};
+  }
+
+  // The first subcommand, or empty if the scan did not reach one.
+  const std::string &name() const { return name_; }
+
+  std::size_t index() const { return index_; }
+
+private:
+  std::string name_;
+  std::size_t index_ = 0;
+};
+
+// Parses a chain of subcommands of group `cmd` that are separated by
+// `separator`, as in `--verbose fetch --url x + transform --strip + upload`.
+// The flags of the group come before the first subcommand. A separator only
+// ends a subcommand where the next one could start, so that it may still be
+// the value of a flag, or follow a `--`. Every subcommand is parsed before
+// the first one runs, so that an error anywhere in the chain is reported
+// before anything ran. The subcommands then run in order with `cmd` as their
+// parent, which carries state from one to the next, and the chain stops at
+// the first error. Arguments without a separator are parsed as usual.
+template <class T>
+result parse_chain(std::nothrow_t, T &cmd, const std::deque<std::string> &a,
+                   std::string_view separator = "+") {
+  if (std::find(a.begin(), a.end(), separator) == a.end())
+    return wahl::parse(std::nothrow, cmd, a);
+  auto ctx = wahl::build_context(cmd);
+  iterator_tokens<std::deque<std::string>::const_iterator> tokens(a.begin(),
+                                                                  a.end());
+  chain_start start;
+  bool completed = false;
+  if (auto e = wahl::scan_arguments(ctx, tokens, start, completed))
+    return e;
+  if (completed) {
+    // The separators were all values of the group's flags.
+    if (auto e = ctx.post_process())
+      return e;
+    phase_scope running{parse_phase::none};
+    wahl::try_run(rank<2>{}, cmd);
+    return ctx.run_item_handlers();
+  }
+  if (start.name().empty())
+    return {};
+
+  phase_scope scope{parse_phase::tokenization};
+  std::vector<std::unique_ptr<prepared_command>> chain;
+  auto &subcommands = T::subcommands();
+  auto name = start.name();
+  for (auto index = start.index();;) {
+    auto &sub = subcommands.at(name);
+    std::deque<std::string> rest(std::next(a.begin(), index + 1), a.end());
+    chain_arguments policy;
+    policy.separator = separator;
+    policy.length = rest.size();
+    std::unique_ptr<prepared_command> prepared;
+    if (not sub.prepare) {
+      // Without its flags, the first separator ends the subcommand.
+      policy.length =
+          std::size_t(std::find(rest.begin(), rest.end(), separator) -
+                      rest.begin());
+      rest.resize(policy.length);
+      prepared = std::make_unique<deferred_command>([&sub, rest, &cmd] {
+#if WAHL_COMPACT
+        return sub(rest, &cmd);
+#else
+        return sub.run(rest, cmd);
+#endif
+      });
+    } else {
+#if WAHL_COMPACT
+      auto e = sub.prepare(rest, policy, &cmd, prepared);
+#else
+      auto e = sub.prepare(rest, policy, prepared, cmd);
+#endif
+      if (e)
+        return e.shift(int(index) + 1);
+    }
+    chain.push_back(std::move(prepared));
+    auto end = index + 1 + policy.length;
+    if (end == a.size())
+      break;
+    index = end + 1;
+    if (index == a.size())
+      return error{error_code::unknown_command, std::string(separator)}
+          .at(int(end));
+    name.clear();
+    if (ctx.has_subcommand(a[index]))
+      name = a[index];
+    else if (auto e = ctx.resolve_subcommand(a[index], name))
+      return e.at(int(index));
+    if (name.empty())
+      return error{error_code::unknown_command, a[index]}.at(int(index));
+  }
+  for (auto &&x : chain)
+    if (auto r = x->run(); not r)
+      return r;
+  return {};
+}
+
+template <class T>
+bool parse_chain(int argc, char const *argv[],
+                 std::string_view separator = "+") {
+  T cmd = {};
+  std::deque<std::string> a(argv + std::min(argc, 1), argv + argc);
+
+  return wahl::report_errors(
+      [&] { return wahl::parse_chain(std::nothrow, cmd, a, separator); });
+}
+
+// A snapshot is a binary image of the fields a command declares in its
+// `parse` function, together with how often each argument was given. It is
+// meant for processes running the same binary, e.g., workers that receive
+// the configuration of a coordinator through shared memory, and stores all
+// values in native byte order. Every record starts at a multiple of 8 bytes,
+// so that arrays can be accessed in place if the blob is suitably aligned.
+enum class snapshot_kind : std::uint32_t {
+  none,    // A field without a value, e.g., `nullptr`.
+  scalar,  // A trivially copyable value.
+  string,  // The characters of a string, followed by a null character.
+  array,   // A container of trivially copyable values.
+  strings, // A container of strings.
+};
+
+struct snapshot_header {
+  char magic[8];
+  std::uint32_t version;
+  std::uint32_t fields;
+  std::uint64_t size;
+};
+
+// Precedes the null-separated flags and the payload of every field.
+struct snapshot_field_header {
+  std::uint32_t count;
+  snapshot_kind kind;
+  std::uint32_t element_size;
+  std::uint32_t flags_size;
+  std::uint64_t size;
+};
+
+inline constexpr char snapshot_magic[8] = {'w', 'a', 'h', 'l',
+                                           's', 'n', 'a', 'p'};
+inline constexpr std::uint32_t snapshot_version = 1;
+
+inline std::size_t snapshot_padded(std::size_t n) {
+  return (n + 7) & ~std::size_t{7};
+}
+
+template <class T> constexpr snapshot_kind snapshot_kind_of() {
+  if constexpr (std::is_same<T, std::nullptr_t>{})
+    return snapshot_kind::none;
+  else if constexpr (std::is_same<T, std::string>{})
+    return snapshot_kind::string;
+  else if constexpr (std::is_trivially_copyable<T>{})
+    return snapshot_kind::scalar;
+  else if constexpr (is_container<T>{}) {
+    using value_type = typename T::value_type;
+    static_assert(std::is_same<value_type, std::string>{} or
+                      std::is_trivially_copyable<value_type>{},
+                  "snapshot: unsupported container element type");
+    return std::is_same<value_type, std::string>{} ? snapshot_kind::strings
+                                                   : snapshot_kind::array;
   } else {
-    return std::make_tuple(s, std::string());
+    static_assert(sizeof(T) == 0, "snapshot: unsupported field type");
+    return snapshot_kind::none;
   }
 }
 
-template <class Container> auto drop(Container c) {
-  c.pop_front();
-  return c;
+template <class T> constexpr std::uint32_t snapshot_element_size() {
+  if constexpr (snapshot_kind_of<T>() == snapshot_kind::scalar)
+    return sizeof(T);
+  else if constexpr (snapshot_kind_of<T>() == snapshot_kind::array)
+    return sizeof(typename T::value_type);
+  else
+    return 0;
 }
 
-template <class T, class... Ts>
-auto try_run(rank<2>, T &x, Ts &&...xs) WAHL_RETURNS(x.run(xs...));
+inline void snapshot_append(std::string &out, const void *data,
+                            std::size_t size) {
+  out.append(static_cast<const char *>(data), size);
+  out.resize(snapshot_padded(out.size()), '\0');
+}
 
-template <class T, class... Ts>
-auto try_run(rank<1>, T &x, Ts &&...) WAHL_RETURNS(x.run())
+template <class T>
+void snapshot_append_value(std::string &out, const T &x) {
+  constexpr auto kind = snapshot_kind_of<T>();
+  if constexpr (kind == snapshot_kind::scalar) {
+    out.append(reinterpret_cast<const char *>(&x), sizeof(T));
+  } else if constexpr (kind == snapshot_kind::string) {
+    out.append(x.data(), x.size() + 1);
+  } else if constexpr (kind == snapshot_kind::array) {
+    for (auto &&y : x)
+      out.append(reinterpret_cast<const char *>(&y), sizeof(y));
+  } else if constexpr (kind == snapshot_kind::strings) {
+    // A table of offsets and sizes relative to the payload, followed by the
+    // null-terminated characters.
+    std::uint64_t n = std::distance(x.begin(), x.end());
+    auto table = out.size();
+    out.append(reinterpret_cast<const char *>(&n), sizeof(n));
+    out.resize(table + (1 + 2 * n) * sizeof(std::uint64_t));
+    std::size_t i = 0;
+    for (auto &&y : x) {
+      std::uint64_t entry[2] = {out.size() - table, y.size()};
+      std::memcpy(&out[table + (1 + 2 * i++) * sizeof(std::uint64_t)], entry,
+                  sizeof(entry));
+      out.append(y.data(), y.size() + 1);
+    }
+  }
+}
 
-    template <class T, class... Ts>
-    void parse(T &cmd, std::deque<std::string> a, Ts &&...xs) {
-  auto ctx = wahl::build_context<Ts...>(cmd);
+// Serializes the fields of a command, together with the counts that
+// `parse_only` reports for them. Missing counts are stored as zero.
+template <class T>
+std::string save_snapshot(T &cmd, const std::vector<int> &counts = {}) {
+  std::string out(sizeof(snapshot_header), '\0');
+  std::uint32_t fields = 0;
+  wahl::try_parse(rank<1>{}, cmd, [&](auto &&x, auto &&...xs) {
+    using field_type = std::decay_t<decltype(x)>;
+    // Constraints are not arguments, and parse_only reports no counts for them.
+    if constexpr (not std::is_same<field_type, constraint>{}) {
+      std::string flags;
+      wahl::each_arg(
+          [&](auto &&y) {
+            if constexpr (std::is_convertible<decltype(y), std::string>{}) {
+              flags += y;
+              flags += '\0';
+            }
+          },
+          xs...);
+      std::string payload;
+      wahl::snapshot_append_value(payload, x);
+
+      snapshot_field_header field = {};
+      field.count = fields < counts.size() ? counts[fields] : 0;
+      field.kind = snapshot_kind_of<field_type>();
+      field.element_size = snapshot_element_size<field_type>();
+      field.flags_size = std::uint32_t(flags.size());
+      field.size = payload.size();
+      snapshot_append(out, &field, sizeof(field));
+      snapshot_append(out, flags.data(), flags.size());
+      snapshot_append(out, payload.data(), payload.size());
+      ++fields;
+    }
+  });
+
+  snapshot_header header = {};
+  std::memcpy(header.magic, snapshot_magic, sizeof(header.magic));
+  header.version = snapshot_version;
+  header.fields = fields;
+  header.size = out.size();
+  std::memcpy(&out[0], &header, sizeof(header));
+  return out;
+}
+
+// Provides access to an array of a snapshot without copying it.
+template <class T> class array_view {
+public:
+  array_view() = default;
+  array_view(const T *data, std::size_t size) : data_(data), size_(size) {}
+
+  const T *begin() const { return data_; }
+  const T *end() const { return data_ + size_; }
+  const T *data() const { return data_; }
+  std::size_t size() const { return size_; }
+  bool empty() const { return size_ == 0; }
+  const T &operator[](std::size_t i) const { return data_[i]; }
+
+private:
+  const T *data_ = nullptr;
+  std::size_t size_ = 0;
+};
+
+// A field of a snapshot. Strings and arrays are views into the snapshot.
+class snapshot_field {
+public:
+  snapshot_field(const snapshot_field_header &header, std::string_view flags,
+                 std::string_view payload)
+      : header_(header), flags_(flags), payload_(payload) {}
+
+  // How often the argument was given when the snapshot was taken.
+  int count() const { return int(header_.count); }
 
-  bool capture = false;
-  std::string core;
-  for (auto &&x : a) {
-    if (ctx.has_subcommand(x)) {
-      ctx.subcommands[x].run(drop(a), cmd, xs...);
-      return;
+  snapshot_kind kind() const { return header_.kind; }
+
+  // The size of a scalar or of the elements of an array.
+  std::size_t element_size() const { return header_.element_size; }
+
+  // The raw payload of the field.
+  std::string_view data() const { return payload_; }
+
+  bool has_flag(std::string_view flag) const {
+    for (auto rest = flags_; not rest.empty();) {
+      auto i = rest.find('\0');
+      if (rest.substr(0, i) == flag)
+        return true;
+      rest.remove_prefix(i + 1);
     }
-    if (x[0] == '-') {
-      capture = false;
-      std::string value;
-      std::tie(core, value) = wahl::parse_attached_value(x);
-
-      if (ctx[core].type == argument_type::none) {
-        if (ctx[core].write(""))
-          return;
-        for (auto &&c : value)
-          if (ctx[std::string("-") + c].write(""))
-            return;
-      } else if (not value.empty()) {
-        ctx[core].write(value);
-      } else {
-        capture = true;
-      }
-    } else if (capture) {
-      if (ctx[core].write(x))
-        return;
-      capture = ctx[core].type == argument_type::multiple;
-    } else if (ctx.has_default_capture()) {
-      ctx[""].write(x);
-    } else {
-      if (core.empty()) {
-        throw std::runtime_error("unknown command: " + x);
-      }
-      if (ctx[core].type == argument_type::none) {
-        throw std::runtime_error("flag: " + core +
-                                 " does not expect an argument.");
-      }
-      if (ctx[core].type != argument_type::multiple) {
-        throw std::runtime_error("flag: " + core +
-                                 " expects only one argument.");
+    return false;
+  }
+
+  template <class T> T value() const {
+    assert(kind() == snapshot_kind::scalar and payload_.size() == sizeof(T));
+    T result;
+    std::memcpy(&result, payload_.data(), sizeof(T));
+    return result;
+  }
+
+  std::string_view string() const {
+    assert(kind() == snapshot_kind::string);
+    return payload_.substr(0, payload_.size() - 1);
+  }
+
+  // Requires the snapshot to be aligned for `T`, which holds for blobs from
+  // `save_snapshot` and for memory mappings.
+  template <class T> array_view<T> array() const {
+    assert(kind() == snapshot_kind::array and
+           header_.element_size == sizeof(T));
+    assert(reinterpret_cast<std::uintptr_t>(payload_.data()) % alignof(T) ==
+           0);
+    return {reinterpret_cast<const T *>(payload_.data()),
+            payload_.size() / sizeof(T)};
+  }
+
+  // The number of elements of an array or of a container of strings.
+  std::size_t size() const {
+    if (kind() == snapshot_kind::array)
+      return payload_.size() / header_.element_size;
+    if (kind() == snapshot_kind::strings)
+      return std::size_t(entry(0));
+    return 0;
+  }
+
+  std::string_view string(std::size_t i) const {
+    assert(kind() == snapshot_kind::strings and i < size());
+    return payload_.substr(entry(1 + 2 * i), entry(2 + 2 * i));
+  }
+
+private:
+  std::uint64_t entry(std::size_t i) const {
+    std::uint64_t x;
+    std::memcpy(&x, payload_.data() + i * sizeof(x), sizeof(x));
+    return x;
+  }
+
+  snapshot_field_header header_;
+  std::string_view flags_;
+  std::string_view payload_;
+};
+
+// Validates a snapshot and indexes its fields. The view does not own the
+// blob, which must outlive it.
+class snapshot_view {
+public:
+  explicit snapshot_view(std::string_view blob) : error_(index(blob)) {
+    if (error_)
+      fields_.clear();
+  }
+
+  explicit operator bool() const { return not error_; }
+
+  const class error &error() const { return error_; }
+
+  std::size_t size() const { return fields_.size(); }
+
+  const snapshot_field &operator[](std::size_t i) const { return fields_[i]; }
+
+  // Returns the field of the argument with the flag, or null.
+  const snapshot_field *find(std::string_view flag) const {
+    for (auto &&field : fields_)
+      if (field.has_flag(flag))
+        return &field;
+    return nullptr;
+  }
+
+private:
+  static class error invalid(std::string detail) {
+    return {error_code::invalid_snapshot, {}, std::move(detail)};
+  }
+
+  class error index(std::string_view blob) {
+    snapshot_header header;
+    if (blob.size() < sizeof(header))
+      return invalid("truncated header");
+    std::memcpy(&header, blob.data(), sizeof(header));
+    if (std::memcmp(header.magic, snapshot_magic, sizeof(header.magic)) != 0)
+      return invalid("bad magic");
+    if (header.version != snapshot_version)
+      return invalid("unsupported version " + std::to_string(header.version));
+    if (header.size > blob.size())
+      return invalid("truncated blob");
+    blob = blob.substr(0, header.size);
+    std::size_t offset = sizeof(header);
+    auto take = [&](std::size_t n, std::string_view &out) {
+      if (n > blob.size() - offset)
+        return false;
+      out = blob.substr(offset, n);
+      offset = std::min(blob.size(), snapshot_padded(offset + n));
+      return true;
+    };
+    fields_.reserve(header.fields);
+    for (std::uint32_t i = 0; i < header.fields; ++i) {
+      std::string_view bytes, flags, payload;
+      if (not take(sizeof(snapshot_field_header), bytes))
+        return invalid("truncated field " + std::to_string(i));
+      snapshot_field_header field;
+      std::memcpy(&field, bytes.data(), sizeof(field));
+      if (not take(field.flags_size, flags) or not take(field.size, payload) or
+          not valid_payload(field, payload))
+        return invalid("malformed field " + std::to_string(i));
+      fields_.emplace_back(field, flags, payload);
+    }
+    return {};
+  }
+
+  static bool valid_payload(const snapshot_field_header &field,
+                            std::string_view payload) {
+    switch (field.kind) {
+      case snapshot_kind::none:
+        return payload.empty();
+      case snapshot_kind::scalar:
+        return payload.size() == field.element_size;
+      case snapshot_kind::string:
+        return not payload.empty() and payload.back() == '\0';
+      case snapshot_kind::array:
+        return field.element_size > 0 and
+               payload.size() % field.element_size == 0;
+      case snapshot_kind::strings: {
+        constexpr auto word = sizeof(std::uint64_t);
+        std::uint64_t n = 0;
+        if (payload.size() < word)
+          return false;
+        std::memcpy(&n, payload.data(), word);
+        if (n > (payload.size() - word) / (2 * word))
+          return false;
+        for (std::uint64_t i = 0; i < n; ++i) {
+          std::uint64_t entry[2];
+          std::memcpy(entry, payload.data() + (1 + 2 * i) * word,
+                      sizeof(entry));
+          if (entry[0] > payload.size() or
+              entry[1] >= payload.size() - entry[0] or
+              payload[entry[0] + entry[1]] != '\0')
+            return false;
+        }
+        return true;
       }
     }
+    return false;
+  }
 
-    a.pop_front();
+  // Declared first, as the constructor fills it while initializing error_.
+  std::vector<snapshot_field> fields_;
+  class error error_;
+};
+
+template <class T>
+void restore_value(const snapshot_field &field, T &x) {
+  constexpr auto kind = snapshot_kind_of<T>();
+  if constexpr (kind == snapshot_kind::scalar) {
+    x = field.value<T>();
+  } else if constexpr (kind == snapshot_kind::string) {
+    x = std::string(field.string());
+  } else if constexpr (kind == snapshot_kind::array) {
+    using value_type = typename T::value_type;
+    x.clear();
+    for (std::size_t i = 0; i < field.size(); ++i) {
+      value_type y;
+      std::memcpy(&y, field.data().data() + i * sizeof(y), sizeof(y));
+      x.insert(x.end(), y);
+    }
+  } else if constexpr (kind == snapshot_kind::strings) {
+    x.clear();
+    for (std::size_t i = 0; i < field.size(); ++i)
+      x.insert(x.end(), std::string(field.string(i)));
   }
-  ctx.post_process();
+}
 
-  wahl::try_run(rank<2>{}, cmd, xs...);
+// Restores the fields of a command from a snapshot taken of the same
+// command type. If `counts` is not null, it receives the stored counts.
+template <class T>
+result restore_snapshot(T &cmd, std::string_view blob,
+                        std::vector<int> *counts = nullptr) {
+  snapshot_view view(blob);
+  if (not view)
+    return view.error();
+  std::size_t i = 0;
+  error e;
+  wahl::try_parse(rank<1>{}, cmd, [&](auto &&x, auto &&...) {
+    using field_type = std::decay_t<decltype(x)>;
+    if constexpr (not std::is_same<field_type, constraint>{}) {
+      if (e)
+        return;
+      if (i >= view.size() or
+          view[i].kind() != snapshot_kind_of<field_type>() or
+          view[i].element_size() != snapshot_element_size<field_type>()) {
+        e = {error_code::invalid_snapshot, {},
+             "field " + std::to_string(i) + " does not match the command"};
+        return;
+      }
+      if constexpr (snapshot_kind_of<field_type>() != snapshot_kind::none)
+        wahl::restore_value(view[i], x);
+      ++i;
+    }
+  });
+  if (not e and i != view.size())
+    e = {error_code::invalid_snapshot, {}, "field count does not match"};
+  if (e)
+    return e;
+  if (counts != nullptr) {
+    counts->clear();
+    for (std::size_t j = 0; j < view.size(); ++j)
+      counts->push_back(view[j].count());
+  }
+  return {};
 }
 
-template <class T, class... Ts>
-void parse(std::deque<std::string> a, Ts &&...xs) {
-  T cmd = {};
+// A command or one of its flags, as found by the help search.
+struct help_document {
+  std::string command;
+  // Empty for the command itself.
+  std::string flags;
+  std::string help;
+};
 
-  wahl::parse(cmd, std::move(a), xs...);
+struct help_match {
+  const help_document *document;
+  double score;
+};
+
+// An inverted index over the names and help texts of commands and flags. Words
+// are split at anything but letters and digits, and compared ignoring case.
+class help_index {
+public:
+  void add(help_document document);
+
+  // Returns up to `limit` documents that contain every word of `terms`, best
+  // first. A word also matches the indexed words it is a prefix of, and words
+  // in command names and flags weigh more than words in help texts.
+  std::vector<help_match> search(std::string_view terms,
+                                 std::size_t limit = 10) const;
+
+  const std::vector<help_document> &documents() const { return documents_; }
+
+private:
+  struct posting {
+    int document;
+    double weight;
+  };
+
+  std::vector<help_document> documents_;
+  std::map<std::string, std::vector<posting>, std::less<>> postings_;
+};
+
+// Prints matches in the format of the help text.
+void print_help_matches(const std::vector<help_match> &matches);
+
+// Creates command `T` and lists its flags, without the implicit help flag.
+template <class T, class Parent> flag_help_list flag_help() {
+  T cmd = {};
+#if WAHL_COMPACT
+  return wahl::compact_flag_help(wahl::describe<T, Parent>(), &cmd);
+#else
+  auto ctx = wahl::build_context(cmd);
+  return wahl::list_flag_help(ctx, 1);
+#endif
 }
 
-template <class T> bool parse(int argc, char const *argv[]) {
-  std::deque<std::string> as(argv + 1, argv + argc);
+// The command behind group::add_help_command. It prints the commands of the
+// group, or with `--search`, the commands and flags that match the terms.
+struct help_search {
+  static const char *name() { return "help"; }
+  static const char *help() { return "Search the help of all commands"; }
 
-  try {
-    wahl::parse<T>(as);
-  } catch (const std::exception &ex) {
-    std::cerr << "Error: " << ex.what() << std::endl;
-    return false;
+  std::vector<std::string> terms;
+  std::size_t limit = 10;
+  std::shared_ptr<const help_index> index;
+
+  template <class F> void parse(F f) {
+    f(terms, "--search", "-s",
+      wahl::help("Show the commands and flags that match all terms"));
+    f(limit, "--limit", wahl::help("Show at most this many matches"));
   }
 
-  return true;
-}
+  void run();
+};
 
 template <class T, class F> struct auto_register {
   static bool auto_register_reg_;
@@ -621,21 +2784,163 @@ template <class T, class F>
 bool auto_register<T, F>::auto_register_reg_ =
     auto_register<T, F>::auto_register_reg_init_();
 
+// Returns the object that `build` built under `key` for the registry state
+// `generation`, and rebuilds it once the generation changes. Parses on several
+// threads share the object of a generation.
+std::shared_ptr<const void>
+registry_cache(const void *key, std::size_t generation,
+               const std::function<std::shared_ptr<const void>()> &build);
+
 template <class Derived> struct group {
+#if WAHL_COMPACT
+  using subcommand_map = compact_subcommand_map;
+#else
   using context_type = context<Derived &>;
   using subcommand_type = typename context_type::subcommand_type;
   using subcommand_map = typename context_type::subcommand_map;
+#endif
 
   static subcommand_map &subcommands() {
     static subcommand_map subcommands_;
     return subcommands_;
   }
 
+  // Counts the registrations, so that the indices over the registry are
+  // rebuilt for subcommands that are added after the first parse.
+  static std::size_t &generation() {
+    static std::size_t generation_ = 0;
+    return generation_;
+  }
+
+  static void add_subcommand(std::string name,
+                             typename subcommand_map::mapped_type sub) {
+    subcommands().emplace(std::move(name), std::move(sub));
+    ++generation();
+  }
+
+  // The prefix index over the registry is built on first use, which is after
+  // all commands registered themselves during static initialization, and
+  // again whenever a subcommand was added since.
+  static std::shared_ptr<const prefix_trie> subcommand_index() {
+    static constexpr char key = 0;
+    return std::static_pointer_cast<const prefix_trie>(
+        wahl::registry_cache(&key, generation(), [] {
+          auto result = std::make_shared<prefix_trie>();
+          int i = 0;
+          for (auto &&p : subcommands())
+            result->insert(p.first, i++);
+          return std::shared_ptr<const void>(std::move(result));
+        }));
+  }
+
   template <class T> static void add_command() {
+#if WAHL_COMPACT
+    compact_subcommand sub;
+    sub.run = [](const std::deque<std::string> &a, void *parent) {
+      T cmd = {};
+      return wahl::parse_compact(wahl::describe<T, Derived>(), &cmd, a,
+                                 parent);
+    };
+    sub.prepare = [](const std::deque<std::string> &a,
+                     chain_arguments &policy, void *parent,
+                     std::unique_ptr<prepared_command> &out) {
+      return wahl::prepare_compact(wahl::describe<T, Derived>(),
+                                   std::make_shared<T>(), a, policy, parent,
+                                   out);
+    };
+#else
     subcommand_type sub;
-    sub.run = [](auto a, auto &&...xs) { wahl::parse<T>(a, xs...); };
+    sub.run = [](auto a, auto &&...xs) {
+      return wahl::parse<T>(std::nothrow, a, xs...);
+    };
+    sub.prepare = [](const std::deque<std::string> &a,
+                     chain_arguments &policy,
+                     std::unique_ptr<prepared_command> &out, Derived &parent) {
+      auto p = std::make_unique<prepared_invocation<T, Derived>>(parent);
+      auto e = p->parse(a, policy);
+      out = std::move(p);
+      return e;
+    };
+#endif
     sub.help = get_help<T>();
-    subcommands().emplace(get_name<T>(), sub);
+    sub.flags = &wahl::flag_help<T, Derived>;
+    add_subcommand(get_name<T>(), std::move(sub));
+  }
+
+  // The help search index over the subcommands and their flags. It is built
+  // on first use, which creates every command once, and again whenever a
+  // subcommand was added since. Plugins are indexed by their name and help
+  // only, because their flags are unknown until the library is loaded.
+  static std::shared_ptr<const help_index> help_search_index() {
+    static constexpr char key = 0;
+    return std::static_pointer_cast<const help_index>(
+        wahl::registry_cache(&key, generation(), [] {
+          auto result = std::make_shared<help_index>();
+          for (auto &&p : subcommands()) {
+            result->add({p.first, {}, p.second.help});
+            if (p.second.flags != nullptr)
+              for (auto &&x : p.second.flags())
+                result->add(
+                    {p.first, std::move(x.first), std::move(x.second)});
+          }
+          return std::shared_ptr<const void>(std::move(result));
+        }));
+  }
+
+  // Registers a subcommand that lists the subcommands, or searches them and
+  // their flags with `help --search <terms>`.
+  static void add_help_command(std::string name = "help") {
+#if WAHL_COMPACT
+    compact_subcommand sub;
+    sub.run = [](const std::deque<std::string> &a, void *) {
+      help_search cmd;
+      cmd.index = help_search_index();
+      return wahl::parse(std::nothrow, cmd, a);
+    };
+#else
+    subcommand_type sub;
+    sub.run = [](auto a, Derived &) {
+      help_search cmd;
+      cmd.index = help_search_index();
+      return wahl::parse(std::nothrow, cmd, a);
+    };
+#endif
+    sub.help = help_search::help();
+    add_subcommand(std::move(name), std::move(sub));
+  }
+
+  // Registers a subcommand that is implemented by the shared library at
+  // `path`, which must export it with WAHL_PLUGIN. Only the name and help are
+  // kept until the subcommand is dispatched, so the group's help does not
+  // load the library.
+  static void add_plugin(std::string name, std::string help, std::string path,
+                         std::string symbol = {}) {
+    auto source = std::make_shared<const plugin>(name, std::move(path),
+                                                 std::move(symbol));
+#if WAHL_COMPACT
+    compact_subcommand sub;
+    sub.run = nullptr;
+    sub.source = std::move(source);
+#else
+    subcommand_type sub;
+    sub.run = [source](auto a, Derived &parent) {
+      return source->run(a, &parent);
+    };
+#endif
+    sub.help = std::move(help);
+    add_subcommand(std::move(name), std::move(sub));
+  }
+
+  // Registers the plugins of the manifest at `path`. Registering is not
+  // synchronized with parsing, so it must not run concurrently with parses of
+  // the group.
+  static error add_plugins(const std::string &path) {
+    std::vector<plugin_manifest_entry> entries;
+    if (auto e = wahl::read_plugin_manifest(path, entries))
+      return e;
+    for (auto &&x : entries)
+      add_plugin(std::move(x.name), std::move(x.help), std::move(x.path));
+    return {};
   }
 
   struct auto_register_command {
@@ -648,4 +2953,293 @@ template <class Derived> struct group {
   void run() {}
 };
 
+// Makes the entry point of a plugin visible to the loader, also when the
+// library is built with hidden symbols by default.
+#if defined(_WIN32)
+#define WAHL_PLUGIN_EXPORT __declspec(dllexport)
+#else
+#define WAHL_PLUGIN_EXPORT __attribute__((visibility("default")))
+#endif
+
+// Exports command `T`, whose `run` takes a `Parent &`, from a plugin library
+// as the entry point that group<Parent>::add_plugin looks up by default. The
+// command must not register itself with the group.
+#define WAHL_PLUGIN(T, Parent)                                                 \
+  extern "C" WAHL_PLUGIN_EXPORT void wahl_plugin_##T(                          \
+      const std::deque<std::string> &args, void *parent,                       \
+      ::wahl::result &out) {                                                   \
+    out = ::wahl::parse<T>(std::nothrow, args,                                 \
+                           *static_cast<Parent *>(parent));                    \
+  }
+
+template <class T> struct member_pointer_traits;
+
+template <class M, class C> struct member_pointer_traits<M C::*> {
+  using member_type = M;
+};
+
+// A static option binds a data member to a fixed set of flags. An option
+// without flags captures positional arguments, like `f(x)` does for commands
+// with a dynamic `parse` function.
+template <auto Member, std::size_t N> struct static_option {
+  using member_type =
+      typename member_pointer_traits<decltype(Member)>::member_type;
+
+  static constexpr std::size_t flag_count = N;
+
+  std::array<std::string_view, N> flags;
+
+  static constexpr argument_type type() {
+    if (std::is_same<member_type, bool>())
+      return argument_type::none;
+    else if (is_container<member_type>() and
+             not std::is_convertible<member_type, std::string>())
+      return argument_type::multiple;
+    else
+      return argument_type::single;
+  }
+
+  constexpr bool matches(std::string_view flag) const {
+    for (auto &&x : flags)
+      if (x == flag)
+        return true;
+    return false;
+  }
+
+  template <class T> static void write(T &cmd, std::string_view value) {
+    phase_scope scope{parse_phase::value_write};
+    if constexpr (type() == argument_type::none)
+      cmd.*Member = true;
+    else
+      wahl::write_value_to(cmd.*Member, std::string(value));
+  }
+
+  template <class T> static argument describe(T &cmd, const static_option &x) {
+    argument arg;
+    arg.type = type();
+    arg.flags.assign(x.flags.begin(), x.flags.end());
+    arg.metavar = wahl::type_to_help(cmd.*Member);
+    return arg;
+  }
+};
+
+template <auto Member, class... Flags>
+constexpr auto option(const Flags &...flags) {
+  return static_option<Member, sizeof...(Flags)>{{std::string_view(flags)...}};
+}
+
+template <auto Member> constexpr auto positional() {
+  return static_option<Member, 0>{};
+}
+
+template <class... Options> struct static_schema {
+  std::tuple<Options...> options;
+
+  constexpr auto all_flags() const {
+    std::array<std::string_view, (Options::flag_count + ... + 0)> result = {};
+    std::size_t n = 0;
+    std::apply(
+        [&](const auto &...xs) {
+          auto append = [&](const auto &x) {
+            for (auto &&flag : x.flags)
+              result[n++] = flag;
+          };
+          (append(xs), ...);
+        },
+        options);
+    return result;
+  }
+
+  constexpr bool has_unique_flags() const {
+    auto flags = all_flags();
+    for (std::size_t i = 0; i < flags.size(); ++i)
+      for (std::size_t j = i + 1; j < flags.size(); ++j)
+        if (flags[i] == flags[j])
+          return false;
+    return true;
+  }
+
+  static constexpr int positional_count() {
+    return ((Options::flag_count == 0 ? 1 : 0) + ... + 0);
+  }
+
+  static constexpr int positional_index() {
+    constexpr bool positional[] = {(Options::flag_count == 0)..., false};
+    for (std::size_t i = 0; i < sizeof...(Options); ++i)
+      if (positional[i])
+        return int(i);
+    return -1;
+  }
+
+  // Returns the index of the option that owns `flag`, or -1 if there is none.
+  constexpr int find(std::string_view flag) const {
+    return find_impl(flag, std::index_sequence_for<Options...>{});
+  }
+
+  template <class F> void visit(int index, F &&f) const {
+    visit_impl(index, f, std::index_sequence_for<Options...>{});
+  }
+
+private:
+  template <std::size_t... Is>
+  constexpr int find_impl(std::string_view flag,
+                          std::index_sequence<Is...>) const {
+    int result = -1;
+    (void)((std::get<Is>(options).matches(flag) ? (result = int(Is), true)
+                                                : false) or
+           ...);
+    return result;
+  }
+
+  template <class F, std::size_t... Is>
+  void visit_impl(int index, F &f, std::index_sequence<Is...>) const {
+    (void)((index == int(Is) ? (f(std::get<Is>(options)), true) : false) or
+           ...);
+  }
+};
+
+template <class... Options>
+constexpr static_schema<Options...> schema(Options... options) {
+  return {{options...}};
+}
+
+// Renders the help text of a static schema. Help is a cold path, so this is
+// the only place where a static command builds a dynamic context.
+template <class T, class Schema>
+void show_static_help(T &cmd, const Schema &schema) {
+  context<T &> ctx;
+  ctx.parse(nullptr, "-h", "--help", wahl::help("Show help"));
+  std::apply(
+      [&](const auto &...xs) {
+        (ctx.add(std::decay_t<decltype(xs)>::describe(cmd, xs)), ...);
+      },
+      schema.options);
+  ctx.show_help(get_name<T>(), get_help<T>(), get_options_metavar<T>());
+}
+
+// Parses the range [first, last) into a command that declares its arguments
+// with a `static constexpr auto schema()` function instead of `parse(F f)`.
+// Flag lookup and value dispatch are resolved at compile time, so no context,
+// lookup table, or type-erased writer is constructed while parsing.
+template <class T, class Iterator, class... Ts>
+result parse_static(std::nothrow_t, T &cmd, Iterator first, Iterator last,
+                    Ts &&...xs) {
+  constexpr auto schema = T::schema();
+  static_assert(schema.has_unique_flags(),
+                "static schema contains a duplicate flag");
+  static_assert(schema.positional_count() <= 1,
+                "static schema contains more than one positional capture");
+  constexpr int positional = schema.positional_index();
+
+  auto command_name = [] { return std::string(get_name<T>()); };
+
+  phase_scope scope{parse_phase::tokenization};
+  if (auto e = wahl::check_limits(iterator_tokens<Iterator>(first, last)))
+    return e;
+  error e;
+  int capture = -1;
+  int core = -1;
+  std::string_view core_flag;
+  for (int index = 0; first != last; ++first, ++index) {
+    std::string_view x = *first;
+    if (not x.empty() and x[0] == '-') {
+      capture = -1;
+      std::string_view value;
+      if (x.size() > 1 and x[1] == '-') {
+        auto i = x.find('=');
+        core_flag = x.substr(0, i);
+        if (i != std::string_view::npos)
+          value = x.substr(i + 1);
+      } else if (x.size() > 2) {
+        core_flag = x.substr(0, 2);
+        value = x.substr(2);
+      } else {
+        core_flag = x;
+      }
+      core = schema.find(core_flag);
+      if (core < 0) {
+        if (core_flag == "-h" or core_flag == "--help") {
+          wahl::show_static_help(cmd, schema);
+          return {};
+        }
+        e = {error_code::unknown_flag, std::string(core_flag)};
+        e.in(command_name);
+      } else {
+        schema.visit(core, [&](const auto &option) {
+          if constexpr (option.type() == argument_type::none) {
+            option.write(cmd, {});
+            for (auto c : value) {
+              const char bundled[] = {'-', c};
+              auto next = schema.find({bundled, 2});
+              if (next < 0) {
+                e = {error_code::unknown_flag, std::string(bundled, 2)};
+                e.in(command_name);
+                return;
+              }
+              schema.visit(next, [&](const auto &other) {
+                if constexpr (other.type() == argument_type::none)
+                  other.write(cmd, {});
+                else
+                  e = {error_code::missing_value, std::string(bundled, 2)};
+              });
+              if (e)
+                return;
+            }
+          } else if (not value.empty()) {
+            option.write(cmd, value);
+          } else {
+            capture = core;
+          }
+        });
+      }
+    } else if (capture >= 0) {
+      schema.visit(capture, [&](const auto &option) {
+        option.write(cmd, x);
+        if (option.type() != argument_type::multiple)
+          capture = -1;
+      });
+    } else if (positional >= 0) {
+      schema.visit(positional,
+                   [&](const auto &option) { option.write(cmd, x); });
+    } else if (core < 0) {
+      e = {error_code::unknown_command, std::string(x)};
+    } else {
+      schema.visit(core, [&](const auto &option) {
+        e = {option.type() == argument_type::none
+                 ? error_code::unexpected_value
+                 : error_code::too_many_values,
+             std::string(core_flag)};
+      });
+    }
+    if (not e)
+      e = take_pending_error();
+    if (e)
+      return e.at(index);
+  }
+
+  phase_scope running{parse_phase::none};
+  wahl::try_run(rank<2>{}, cmd, xs...);
+  return {};
+}
+
+template <class T, class Iterator, class... Ts>
+void parse_static(T &cmd, Iterator first, Iterator last, Ts &&...xs) {
+  if (auto r = wahl::parse_static(std::nothrow, cmd, first, last, xs...);
+      not r)
+    wahl::raise(r.error());
+}
+
+template <class T, class... Ts>
+void parse_static(T &cmd, const std::deque<std::string> &a, Ts &&...xs) {
+  wahl::parse_static(cmd, a.begin(), a.end(), xs...);
+}
+
+template <class T> bool parse_static(int argc, char const *argv[]) {
+  T cmd = {};
+
+  return wahl::report_errors([&] {
+    return wahl::parse_static(std::nothrow, cmd, argv + 1, argv + argc);
+  });
+}
+
 } // namespace wahl
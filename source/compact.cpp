@@ -0,0 +1,143 @@
+// SPDX-License-Identifier: BSL-1.0
+
+#include <wahl/wahl.hpp>
+
+namespace wahl {
+
+namespace {
+
+// The context of a described command. Its subcommands come from the registry
+// of a group rather than from a map per command type.
+class compact_context final : public context_base {
+public:
+  explicit compact_context(const command_descriptor &d)
+      : context_base(d.name), subcommands(d.subcommands()) {}
+
+  bool has_subcommand(const std::string &x) const override {
+    return subcommands != nullptr and subcommands->count(x) > 0 and
+           x != name();
+  }
+
+  std::vector<std::pair<std::string, std::string>>
+  subcommand_list() const override {
+    std::vector<std::pair<std::string, std::string>> result;
+    if (subcommands != nullptr)
+      for (auto &&p : *subcommands)
+        result.emplace_back(p.first, p.second.help);
+    return result;
+  }
+
+  const compact_subcommand_map *subcommands;
+};
+
+using deque_tokens = iterator_tokens<std::deque<std::string>::const_iterator>;
+
+// Rejects unknown arguments like strict_arguments, and dispatches to the
+// subcommands of the context with the command as their parent.
+class compact_handler final : public scan_handler {
+public:
+  compact_handler(const compact_context &ctx, const std::deque<std::string> &a,
+                  void *cmd, chain_arguments *chain)
+      : ctx_(ctx), a_(a), cmd_(cmd), chain_(chain) {}
+
+  bool unknown(std::size_t) override { return false; }
+
+  bool terminate(std::size_t) override { return false; }
+
+  error dispatch(const std::string &name, std::size_t index) override {
+    auto rest = std::deque<std::string>(
+        std::next(a_.begin(), std::ptrdiff_t(index) + 1), a_.end());
+    auto e = ctx_.subcommands->at(name)(rest, cmd_).error();
+    return e.shift(int(index) + 1);
+  }
+
+  bool separates(std::size_t index) override {
+    return chain_ != nullptr and
+           chain_->separates(std::next(a_.begin(), std::ptrdiff_t(index)),
+                             index);
+  }
+
+private:
+  const compact_context &ctx_;
+  const std::deque<std::string> &a_;
+  void *cmd_;
+  // The chain that the command is part of, or null.
+  chain_arguments *chain_;
+};
+
+// Parses the arguments into a described command, and runs it later.
+class compact_invocation final : public prepared_command {
+public:
+  compact_invocation(const command_descriptor &d, void *cmd, void *parent)
+      : d_(d), ctx_(d), cmd_(cmd), parent_(parent) {}
+
+  error parse(const std::deque<std::string> &a,
+              chain_arguments *chain = nullptr) {
+    {
+      phase_scope scope{parse_phase::context_build};
+      auto &d = d_;
+      wahl::declare_argument(
+          ctx_, nullptr, "-h", "--help", wahl::help("Show help"),
+          wahl::eager_callback(
+              [&d](std::nullptr_t, const context_base &c, const argument &) {
+                c.show_help(d.name(), d.help(), d.options_metavar());
+              }));
+      d_.declare(cmd_, ctx_);
+      ctx_.resolve_constraints();
+      if (d_.abbreviations)
+        ctx_.enable_abbreviations();
+    }
+    deque_tokens tokens(a.begin(), a.end());
+    compact_handler handler(ctx_, a, cmd_, chain);
+    if (auto e = wahl::scan_arguments(ctx_, tokens, handler, completed_))
+      return e;
+    return completed_ ? ctx_.post_process() : error{};
+  }
+
+  result run() override {
+    if (not completed_)
+      return {};
+    phase_scope running{parse_phase::none};
+    d_.run(cmd_, parent_);
+    return ctx_.run_item_handlers();
+  }
+
+  // Keeps the command alive for a later run.
+  std::shared_ptr<void> owner;
+
+private:
+  const command_descriptor &d_;
+  compact_context ctx_;
+  void *cmd_;
+  void *parent_;
+  bool completed_ = false;
+};
+
+} // namespace
+
+result parse_compact(const command_descriptor &d, void *cmd,
+                     const std::deque<std::string> &a, void *parent) {
+  compact_invocation invocation(d, cmd, parent);
+  if (auto e = invocation.parse(a))
+    return e;
+  return invocation.run();
+}
+
+error prepare_compact(const command_descriptor &d, std::shared_ptr<void> cmd,
+                      const std::deque<std::string> &a,
+                      chain_arguments &policy, void *parent,
+                      std::unique_ptr<prepared_command> &out) {
+  auto invocation = std::make_unique<compact_invocation>(d, cmd.get(), parent);
+  invocation->owner = std::move(cmd);
+  auto e = invocation->parse(a, &policy);
+  out = std::move(invocation);
+  return e;
+}
+
+flag_help_list compact_flag_help(const command_descriptor &d, void *cmd) {
+  compact_context ctx(d);
+  d.declare(cmd, ctx);
+  return wahl::list_flag_help(ctx);
+}
+
+} // namespace wahl
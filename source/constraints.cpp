@@ -0,0 +1,136 @@
+// SPDX-License-Identifier: BSL-1.0
+
+#include <wahl/wahl.hpp>
+
+#include <bitset>
+
+namespace wahl {
+
+namespace {
+
+using word = std::uint64_t;
+
+constexpr std::size_t word_bits = 64;
+
+bool grouped(constraint_kind kind) {
+  return kind == constraint_kind::exactly_one or
+         kind == constraint_kind::at_most_one;
+}
+
+void set(constraint_mask &m, std::size_t i) {
+  auto w = i / word_bits;
+  auto bit = word{1} << (i % word_bits);
+  for (auto &&p : m.words) {
+    if (p.first == w) {
+      p.second |= bit;
+      return;
+    }
+  }
+  m.words.emplace_back(w, bit);
+}
+
+// The number of bits set in both the mask and `bits`.
+std::size_t count(const constraint_mask &m, const std::vector<word> &bits) {
+  std::size_t result = 0;
+  for (auto &&p : m.words)
+    result += std::bitset<word_bits>(bits[p.first] & p.second).count();
+  return result;
+}
+
+bool test(const std::vector<word> &bits, std::size_t i) {
+  return (bits[i / word_bits] >> (i % word_bits)) & 1;
+}
+
+// Joins flags as "a, b and c".
+std::string enumerate(const std::vector<std::string> &flags) {
+  std::string result;
+  for (std::size_t i = 0; i < flags.size(); ++i) {
+    if (i > 0)
+      result += i + 1 == flags.size() ? " and " : ", ";
+    result += flags[i];
+  }
+  return result;
+}
+
+} // namespace
+
+void context_base::resolve_constraints() {
+  constraint_masks.clear();
+  constraint_masks.reserve(constraints.size());
+  for (auto &&c : constraints) {
+    constraint_mask m;
+    for (auto &&flag : c.flags) {
+      auto it = lookup.find(flag);
+      if (it == lookup.end() or flag.empty()) {
+        if (not declaration_error)
+          declaration_error = unknown_flag(flag);
+        it = lookup.end();
+      }
+      m.indices.push_back(it == lookup.end() ? -1 : it->second);
+    }
+    for (auto i = grouped(c.kind) ? 0 : 1; i < int(m.indices.size()); ++i)
+      if (m.indices[i] >= 0)
+        set(m, std::size_t(m.indices[i]));
+    constraint_masks.push_back(std::move(m));
+  }
+}
+
+error context_base::check_constraints() const {
+  if (constraints.empty())
+    return {};
+  if (declaration_error)
+    return declaration_error;
+  std::vector<word> given((slots.size() + word_bits - 1) / word_bits);
+  for (std::size_t i = 0; i < slots.size(); ++i)
+    if (slots[i].count > 0)
+      given[i / word_bits] |= word{1} << (i % word_bits);
+
+  std::vector<std::string> violations;
+  for (std::size_t k = 0; k < constraints.size(); ++k) {
+    auto &c = constraints[k];
+    auto &m = constraint_masks[k];
+    // Implies and conflicts are about their first flag.
+    bool group = grouped(c.kind);
+    if (not group and not test(given, m.indices.front()))
+      continue;
+    auto n = count(m, given);
+    // Lists the flags of the constraint that were (or were not) given.
+    auto select = [&](bool was_given) {
+      std::vector<std::string> result;
+      for (auto i = group ? 0 : 1; i < int(m.indices.size()); ++i)
+        if (test(given, m.indices[i]) == was_given)
+          result.push_back(c.flags[i]);
+      return result;
+    };
+    switch (c.kind) {
+      case constraint_kind::exactly_one:
+        if (n == 0) {
+          violations.push_back("one of " + join(c.flags, ", ") +
+                               " is required");
+          break;
+        }
+        [[fallthrough]];
+      case constraint_kind::at_most_one:
+        if (n > 1)
+          violations.push_back(enumerate(select(true)) +
+                               " cannot be used together");
+        break;
+      case constraint_kind::implies:
+        if (n < m.indices.size() - 1)
+          violations.push_back(c.flags.front() + " requires " +
+                               enumerate(select(false)));
+        break;
+      case constraint_kind::conflicts:
+        if (n > 0)
+          violations.push_back(c.flags.front() + " cannot be used with " +
+                               enumerate(select(true)));
+        break;
+    }
+  }
+  if (violations.empty())
+    return {};
+  return error{error_code::constraint_violation, {}, join(violations, "; ")}
+      .in(name);
+}
+
+} // namespace wahl
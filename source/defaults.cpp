@@ -0,0 +1,37 @@
+// SPDX-License-Identifier: BSL-1.0
+
+#include <wahl/wahl.hpp>
+
+#include <mutex>
+
+namespace wahl {
+
+namespace {
+
+struct default_entry {
+  std::once_flag once;
+  std::shared_ptr<const void> value;
+};
+
+} // namespace
+
+const std::shared_ptr<const void> &
+cached_default(const void *tag, std::string (*name)(), std::size_t index,
+               const std::function<std::shared_ptr<const void>()> &compute) {
+  static std::mutex mutex;
+  // Entries are never erased, and map nodes do not move, so the entry stays
+  // valid after the lock is released.
+  static std::map<std::tuple<std::uintptr_t, std::uintptr_t, std::size_t>,
+                  default_entry>
+      entries;
+  default_entry *entry;
+  {
+    std::lock_guard<std::mutex> lock(mutex);
+    entry = &entries[{reinterpret_cast<std::uintptr_t>(tag),
+                      reinterpret_cast<std::uintptr_t>(name), index}];
+  }
+  std::call_once(entry->once, [&] { entry->value = compute(); });
+  return entry->value;
+}
+
+} // namespace wahl
@@ -0,0 +1,195 @@
+// SPDX-License-Identifier: BSL-1.0
+
+#include <wahl/wahl.hpp>
+
+#include <exception>
+#include <mutex>
+
+namespace wahl {
+
+namespace {
+
+// A slice [first, last) of the item indices, packed into one word so that its
+// owner and thieves can update it with a single compare-and-swap.
+class slice {
+public:
+  void assign(std::uint64_t first, std::uint64_t last) {
+    bounds_.store(first << 32 | last);
+  }
+
+  // Takes the first index of the slice, which only its owner does.
+  bool pop(std::size_t &i) {
+    auto x = bounds_.load();
+    while (first(x) < last(x))
+      if (bounds_.compare_exchange_weak(x, x + (std::uint64_t{1} << 32))) {
+        i = first(x);
+        return true;
+      }
+    return false;
+  }
+
+  // Takes the upper half of the remaining indices, rounded up.
+  bool steal(std::uint64_t &from, std::uint64_t &to) {
+    auto x = bounds_.load();
+    while (first(x) < last(x)) {
+      auto middle = first(x) + (last(x) - first(x)) / 2;
+      if (bounds_.compare_exchange_weak(x, first(x) << 32 | middle)) {
+        from = middle;
+        to = last(x);
+        return true;
+      }
+    }
+    return false;
+  }
+
+  std::uint64_t remaining() const {
+    auto x = bounds_.load(std::memory_order_relaxed);
+    return last(x) - first(x);
+  }
+
+private:
+  static std::uint64_t first(std::uint64_t x) { return x >> 32; }
+
+  static std::uint64_t last(std::uint64_t x) { return x & 0xffffffff; }
+
+  // Each slice has a cache line of its own, so that owners popping indices
+  // do not slow each other down.
+  alignas(64) std::atomic<std::uint64_t> bounds_{0};
+};
+
+struct item_run {
+  bool (*task)(void *, std::size_t, std::string &);
+  void *f;
+  bool ordered;
+  std::atomic<bool> cancelled{false};
+  std::mutex mutex;
+  // The first failed item, and its error or exception.
+  std::size_t failed = std::size_t(-1);
+  error failure;
+#if WAHL_EXCEPTIONS
+  std::exception_ptr exception;
+#endif
+  // The outputs that wait for their predecessors when printing in order.
+  std::vector<std::string> outputs;
+  std::vector<char> done;
+  std::size_t next_output = 0;
+
+#if WAHL_EXCEPTIONS
+  void fail(std::size_t i, error e, std::exception_ptr ex = nullptr) {
+#else
+  void fail(std::size_t i, error e) {
+#endif
+    std::lock_guard<std::mutex> lock(mutex);
+    if (i < failed) {
+      failed = i;
+      failure = std::move(e);
+#if WAHL_EXCEPTIONS
+      exception = std::move(ex);
+#endif
+    }
+    cancelled = true;
+  }
+
+  void finish(std::size_t i, bool has_output, std::string &output) {
+    std::lock_guard<std::mutex> lock(mutex);
+    if (not ordered) {
+      if (has_output)
+        wahl::print_line(output);
+      return;
+    }
+    outputs[i] = std::move(output);
+    done[i] = has_output ? 2 : 1;
+    for (; next_output < done.size() and done[next_output] != 0;
+         ++next_output) {
+      if (done[next_output] == 2)
+        wahl::print_line(outputs[next_output]);
+      outputs[next_output] = {};
+    }
+  }
+
+  void execute(std::size_t i) {
+    std::string output;
+    bool has_output = false;
+#if WAHL_EXCEPTIONS
+    try {
+      has_output = task(f, i, output);
+    } catch (...) {
+      take_pending_error();
+      fail(i, {}, std::current_exception());
+      return;
+    }
+#else
+    // Without exceptions, items can only fail through wahl::fail.
+    has_output = task(f, i, output);
+#endif
+    if (auto e = take_pending_error())
+      fail(i, std::move(e));
+    else
+      finish(i, has_output, output);
+  }
+};
+
+} // namespace
+
+error for_each_item(std::size_t n, const execution &exec,
+                    bool (*task)(void *, std::size_t, std::string &),
+                    void *f) {
+  assert(n <= 0xffffffff);
+  item_run run;
+  run.task = task;
+  run.f = f;
+  run.ordered = exec.ordered;
+  if (run.ordered) {
+    run.outputs.resize(n);
+    run.done.resize(n);
+  }
+
+  auto work = [&](thread_pool &pool) {
+    auto threads = std::min(pool.size(), std::max<std::size_t>(n, 1));
+    std::vector<slice> slices(threads);
+    for (std::size_t t = 0; t < threads; ++t)
+      slices[t].assign(n * t / threads, n * (t + 1) / threads);
+    pool.run(threads, [&](std::size_t t) {
+      auto &own = slices[t];
+      for (;;) {
+        std::size_t i;
+        while (not run.cancelled and own.pop(i))
+          run.execute(i);
+        if (run.cancelled)
+          return;
+        // Steal from the slice with the most remaining indices. The slice of
+        // this thread is empty, so nobody else modifies it concurrently.
+        auto victim = std::max_element(
+            slices.begin(), slices.end(), [](const slice &x, const slice &y) {
+              return x.remaining() < y.remaining();
+            });
+        if (victim->remaining() == 0)
+          return;
+        std::uint64_t from, to;
+        if (victim->steal(from, to))
+          own.assign(from, to);
+      }
+    });
+  };
+  if (exec.jobs == 0) {
+    work(thread_pool::shared());
+  } else {
+    thread_pool pool(exec.jobs);
+    work(pool);
+  }
+
+#if WAHL_EXCEPTIONS
+  if (run.exception)
+    std::rethrow_exception(run.exception);
+#endif
+  return std::move(run.failure);
+}
+
+error context_base::run_item_handlers() {
+  for (auto &&f : item_handlers)
+    if (auto e = f())
+      return e;
+  return {};
+}
+
+} // namespace wahl
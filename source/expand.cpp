@@ -0,0 +1,438 @@
+// SPDX-License-Identifier: BSL-1.0
+
+#include <wahl/wahl.hpp>
+
+#include <algorithm>
+#include <cctype>
+#include <charconv>
+#include <cstring>
+#include <filesystem>
+#include <map>
+
+namespace wahl {
+
+namespace {
+
+namespace fs = std::filesystem;
+
+// Words are kept with a backslash before every quoted character that would
+// otherwise take part in an expansion, so that the expansions only need to
+// skip escaped characters.
+bool is_special(char c) {
+  return std::strchr("\\{},.*?[]", c) != nullptr and c != '\0';
+}
+
+void append_literal(std::string &word, char c) {
+  if (is_special(c))
+    word += '\\';
+  word += c;
+}
+
+std::string unescape(std::string_view word) {
+  std::string result;
+  result.reserve(word.size());
+  for (std::size_t i = 0; i < word.size(); ++i) {
+    if (word[i] == '\\' and i + 1 < word.size())
+      ++i;
+    result += word[i];
+  }
+  return result;
+}
+
+bool has_glob(std::string_view word) {
+  for (std::size_t i = 0; i < word.size(); ++i) {
+    if (word[i] == '\\')
+      ++i;
+    else if (word[i] == '*' or word[i] == '?' or word[i] == '[')
+      return true;
+  }
+  return false;
+}
+
+// Matches `c` against the pattern element at `p[i]`, and stores the position
+// after the element in `next`.
+bool match_one(std::string_view p, std::size_t i, char c, std::size_t &next) {
+  if (p[i] == '\\' and i + 1 < p.size()) {
+    next = i + 2;
+    return p[i + 1] == c;
+  }
+  if (p[i] == '?') {
+    next = i + 1;
+    return true;
+  }
+  if (p[i] == '[') {
+    auto j = i + 1;
+    auto negate = j < p.size() and (p[j] == '!' or p[j] == '^');
+    if (negate)
+      ++j;
+    bool matched = false;
+    for (auto first = j; j < p.size() and (p[j] != ']' or j == first); ++j) {
+      auto low = p[j];
+      if (low == '\\' and j + 1 < p.size())
+        low = p[++j];
+      auto high = low;
+      if (j + 2 < p.size() and p[j + 1] == '-' and p[j + 2] != ']') {
+        j += 2;
+        high = p[j] == '\\' and j + 1 < p.size() ? p[++j] : p[j];
+      }
+      matched = matched or (low <= c and c <= high);
+    }
+    // An unterminated class is a literal '['.
+    if (j < p.size()) {
+      next = j + 1;
+      return matched != negate;
+    }
+  }
+  next = i + 1;
+  return p[i] == c;
+}
+
+// Matches a name against one path component of a pattern. A star remembers
+// where it matched, and a mismatch retries from there with one more
+// character, which keeps typical patterns linear in the length of the name.
+bool match(std::string_view p, std::string_view name) {
+  std::size_t i = 0, j = 0;
+  auto star = std::string_view::npos;
+  std::size_t mark = 0;
+  while (j < name.size()) {
+    std::size_t next;
+    if (i < p.size() and p[i] == '*') {
+      star = ++i;
+      mark = j;
+    } else if (i < p.size() and match_one(p, i, name[j], next)) {
+      i = next;
+      ++j;
+    } else if (star != std::string_view::npos) {
+      i = star;
+      j = ++mark;
+    } else {
+      return false;
+    }
+  }
+  while (i < p.size() and p[i] == '*')
+    ++i;
+  return i == p.size();
+}
+
+bool parse_integer(std::string_view x, long long &result) {
+  auto last = x.data() + x.size();
+  auto r = std::from_chars(x.data(), last, result);
+  return not x.empty() and r.ec == std::errc() and r.ptr == last;
+}
+
+// Parses a sequence `first..last[..step]` of integers or characters.
+bool parse_sequence(std::string_view x, long long &first, long long &last,
+                    long long &step, int &width, bool &characters) {
+  auto dots = x.find("..");
+  if (dots == std::string_view::npos or x.find('\\') != std::string_view::npos)
+    return false;
+  auto from = x.substr(0, dots);
+  auto rest = x.substr(dots + 2);
+  auto to = rest.substr(0, rest.find(".."));
+  step = 1;
+  if (to.size() < rest.size()) {
+    auto by = rest.substr(to.size() + 2);
+    if (not parse_integer(by, step) or step == 0)
+      return false;
+    step = step < 0 ? -step : step;
+  }
+  characters = from.size() == 1 and to.size() == 1 and
+               std::isalpha(static_cast<unsigned char>(from[0])) and
+               std::isalpha(static_cast<unsigned char>(to[0]));
+  if (characters) {
+    first = from[0];
+    last = to[0];
+    width = 0;
+    return true;
+  }
+  if (not parse_integer(from, first) or not parse_integer(to, last))
+    return false;
+  // Like bash, a leading zero pads all numbers to the same width.
+  auto padded = [](std::string_view x) {
+    if (not x.empty() and x[0] == '-')
+      x.remove_prefix(1);
+    return x.size() > 1 and x[0] == '0';
+  };
+  width = padded(from) or padded(to) ? int(std::max(from.size(), to.size()))
+                                     : 0;
+  return true;
+}
+
+class expander {
+public:
+  expander(const std::function<bool(const std::string &)> &f,
+           const expansion &options)
+      : f_(f), options_(options), limits_(active_limits()) {}
+
+  // Expands a word, and returns false once the caller or an error stopped
+  // the expansion.
+  bool word(const std::string &w) {
+    return options_.braces ? braces(w, 0) : glob(w);
+  }
+
+  error take_error() { return std::move(error_); }
+
+private:
+  bool braces(const std::string &w, std::size_t from) {
+    // Finds the first brace with a matching close brace after `from`.
+    auto open = from;
+    for (; open < w.size(); ++open) {
+      if (w[open] == '\\') {
+        ++open;
+        continue;
+      }
+      if (w[open] != '{')
+        continue;
+      std::vector<std::size_t> commas;
+      int depth = 0;
+      for (auto i = open + 1; i < w.size(); ++i) {
+        if (w[i] == '\\') {
+          ++i;
+        } else if (w[i] == '{') {
+          ++depth;
+        } else if (w[i] == ',' and depth == 0) {
+          commas.push_back(i);
+        } else if (w[i] == '}' and depth-- == 0) {
+          if (not commas.empty())
+            return alternatives(w, open, commas, i);
+          return sequence(w, open, i);
+        }
+      }
+    }
+    return glob(w);
+  }
+
+  bool alternatives(const std::string &w, std::size_t open,
+                    const std::vector<std::size_t> &commas,
+                    std::size_t close) {
+    auto first = open + 1;
+    for (std::size_t k = 0; k <= commas.size(); ++k) {
+      auto last = k < commas.size() ? commas[k] : close;
+      auto x = w.substr(0, open);
+      x.append(w, first, last - first);
+      x.append(w, close + 1);
+      // The alternative may contain braces itself.
+      if (not braces(x, open))
+        return false;
+      first = last + 1;
+    }
+    return true;
+  }
+
+  bool sequence(const std::string &w, std::size_t open, std::size_t close) {
+    long long first, last, step;
+    int width;
+    bool characters;
+    auto inner = std::string_view(w).substr(open + 1, close - open - 1);
+    if (not parse_sequence(inner, first, last, step, width, characters))
+      return braces(w, open + 1);
+    auto prefix = w.substr(0, open);
+    auto suffix = w.substr(close + 1);
+    auto down = last < first;
+    for (auto i = first; down ? i >= last : i <= last;
+         i += down ? -step : step) {
+      std::string item;
+      if (characters) {
+        append_literal(item, char(i));
+      } else {
+        item = std::to_string(i < 0 ? -i : i);
+        if (item.size() + (i < 0) < std::size_t(width))
+          item.insert(0, width - item.size() - (i < 0), '0');
+        if (i < 0)
+          item.insert(0, 1, '-');
+      }
+      if (not braces(prefix + item + suffix, prefix.size() + item.size()))
+        return false;
+    }
+    return true;
+  }
+
+  bool glob(const std::string &w) {
+    if (not options_.globs or not has_glob(w))
+      return emit(unescape(w));
+    std::vector<std::string_view> components;
+    std::string_view rest = w;
+    std::string base;
+    if (not rest.empty() and rest[0] == '/') {
+      base = "/";
+      rest.remove_prefix(1);
+    }
+    for (auto slash = rest.find('/'); slash != std::string_view::npos;
+         slash = rest.find('/')) {
+      components.push_back(rest.substr(0, slash));
+      rest.remove_prefix(slash + 1);
+    }
+    components.push_back(rest);
+    auto matched = matches_;
+    if (not walk(base, components, 0))
+      return false;
+    return matches_ != matched or emit(unescape(w));
+  }
+
+  // Matches the components from `i` on in the directory `path`.
+  bool walk(const std::string &path,
+            const std::vector<std::string_view> &components, std::size_t i) {
+    auto child = [&](std::string_view name) {
+      if (path.empty())
+        return std::string(name);
+      return path.back() == '/' ? path + std::string(name)
+                                : path + "/" + std::string(name);
+    };
+    auto last = i + 1 == components.size();
+    auto p = components[i];
+    std::error_code ec;
+    if (p.empty()) {
+      // A trailing slash only matches directories.
+      if (last)
+        return not fs::is_directory(path, ec) or match_found(path + "/");
+      return walk(path.empty() ? "/" : path, components, i + 1);
+    }
+    if (not has_glob(p)) {
+      auto next = child(unescape(p));
+      if (last)
+        return not fs::exists(fs::symlink_status(next, ec)) or
+               match_found(next);
+      return not fs::is_directory(next, ec) or walk(next, components, i + 1);
+    }
+    // Hidden files match only patterns that start with a dot.
+    auto hidden =
+        p[0] == '.' or (p.size() > 1 and p[0] == '\\' and p[1] == '.');
+    for (auto &&name : listing(path.empty() ? "." : path)) {
+      if ((name[0] == '.' and not hidden) or not match(p, name))
+        continue;
+      auto next = child(name);
+      if (last) {
+        if (not match_found(next))
+          return false;
+      } else if (fs::is_directory(next, ec)) {
+        if (not walk(next, components, i + 1))
+          return false;
+      }
+    }
+    return true;
+  }
+
+  // The sorted names in a directory. Patterns that share a prefix, e.g.,
+  // after brace expansion, read the directory only once.
+  const std::vector<std::string> &listing(const std::string &path) {
+    auto it = listings_.find(path);
+    if (it != listings_.end())
+      return it->second;
+    auto &names = listings_[path];
+    std::error_code ec;
+    for (fs::directory_iterator d(path, ec), end; not ec and d != end;
+         d.increment(ec))
+      names.push_back(d->path().filename().string());
+    std::sort(names.begin(), names.end());
+    return names;
+  }
+
+  bool match_found(std::string path) {
+    ++matches_;
+    return emit(std::move(path));
+  }
+
+  bool emit(std::string x) {
+    ++count_;
+    if (options_.max_arguments != 0 and count_ > options_.max_arguments) {
+      error_ = limit_exceeded({}, options_.max_arguments, "arguments");
+      return false;
+    }
+    if (limits_ != nullptr) {
+      bytes_ += x.size();
+      if (limits_->max_tokens != 0 and count_ > limits_->max_tokens)
+        error_ = limit_exceeded({}, limits_->max_tokens, "tokens");
+      else if (limits_->max_token_length != 0 and
+               x.size() > limits_->max_token_length)
+        error_ = limit_exceeded(x.substr(0, 32) + "...",
+                                limits_->max_token_length, "bytes in a token");
+      else if (limits_->max_bytes != 0 and bytes_ > limits_->max_bytes)
+        error_ = limit_exceeded({}, limits_->max_bytes, "bytes of arguments");
+      if (error_)
+        return false;
+    }
+    return f_(x);
+  }
+
+  static error limit_exceeded(std::string token, std::size_t limit,
+                              const char *what) {
+    return {error_code::limit_exceeded, std::move(token),
+            "more than " + std::to_string(limit) + " " + what};
+  }
+
+  const std::function<bool(const std::string &)> &f_;
+  const expansion &options_;
+  const limits *limits_;
+  std::size_t count_ = 0;
+  std::size_t bytes_ = 0;
+  std::size_t matches_ = 0;
+  std::map<std::string, std::vector<std::string>> listings_;
+  error error_;
+};
+
+} // namespace
+
+error split_arguments(std::string_view line,
+                      const std::function<bool(const std::string &)> &f,
+                      const expansion &options) {
+  expander x(f, options);
+  std::string word;
+  bool in_word = false;
+  for (std::size_t i = 0; i < line.size(); ++i) {
+    auto c = line[i];
+    if (c == ' ' or c == '\t' or c == '\n' or c == '\r') {
+      if (in_word and not x.word(word))
+        return x.take_error();
+      word.clear();
+      in_word = false;
+      continue;
+    }
+    in_word = true;
+    if (c == '\\' and i + 1 < line.size()) {
+      append_literal(word, line[++i]);
+    } else if (c == '\'') {
+      auto end = line.find('\'', i + 1);
+      if (end == std::string_view::npos)
+        return {error_code::invalid_value, std::string(line),
+                "unterminated quote"};
+      for (++i; i < end; ++i)
+        append_literal(word, line[i]);
+    } else if (c == '"') {
+      for (++i; i < line.size() and line[i] != '"'; ++i) {
+        // Within double quotes, a backslash only escapes these characters.
+        if (line[i] == '\\' and i + 1 < line.size() and
+            std::strchr("\"\\$`", line[i + 1]) != nullptr)
+          ++i;
+        append_literal(word, line[i]);
+      }
+      if (i == line.size())
+        return {error_code::invalid_value, std::string(line),
+                "unterminated quote"};
+    } else {
+      word += c;
+    }
+  }
+  if (in_word and not x.word(word))
+    return x.take_error();
+  return {};
+}
+
+error split_arguments(std::string_view line, std::deque<std::string> &result,
+                      const expansion &options) {
+  // The collected arguments are charged as they stream in, so that the memory
+  // budget stops an expansion before it is stored.
+  error charged;
+  auto e = wahl::split_arguments(
+      line,
+      [&](const std::string &x) {
+        charged = charge_memory(x.size() + sizeof(std::string));
+        if (charged)
+          return false;
+        result.push_back(x);
+        return true;
+      },
+      options);
+  return charged ? charged : e;
+}
+
+} // namespace wahl
@@ -0,0 +1,188 @@
+// SPDX-License-Identifier: BSL-1.0
+
+#include <wahl/wahl.hpp>
+
+#include <iomanip>
+#include <iostream>
+#include <numeric>
+#include <sstream>
+
+namespace wahl {
+
+std::vector<std::string> wrap(const std::string &text,
+                              unsigned int line_length) {
+  std::vector<std::string> output;
+  std::istringstream iss(text);
+
+  std::string line;
+
+  do {
+    std::string word;
+    iss >> word;
+
+    if (line.length() + word.length() > line_length) {
+      output.push_back(line);
+      line.clear();
+    }
+    line += word + " ";
+
+  } while (iss);
+
+  if (!line.empty()) {
+    output.push_back(line);
+  }
+  return output;
+}
+
+std::string join(const std::vector<std::string> &xs,
+                 const std::string &delim) {
+  return std::accumulate(xs.begin(), xs.end(), std::string(),
+                         [&](const std::string &x, const std::string &y) {
+                           if (x.empty())
+                             return y;
+                           if (y.empty())
+                             return x;
+                           return x + delim + y;
+                         });
+}
+
+void print_line(std::string_view text) { std::cout << text << std::endl; }
+
+void print_error(std::string_view message) {
+  std::cerr << "Error: " << message << std::endl;
+}
+
+std::string error::message() const {
+  auto command = command_ ? command_() + ": " : std::string();
+  switch (code_) {
+    case error_code::none:
+      return {};
+    case error_code::unknown_flag:
+      return command + "unknown flag: " + token_;
+    case error_code::unknown_command:
+      return "unknown command: " + token_;
+    case error_code::ambiguous_flag:
+      return command + "ambiguous flag: " + token_ + " could be " + detail_;
+    case error_code::ambiguous_command:
+      return command + "ambiguous command: " + token_ + " could be " +
+             detail_;
+    case error_code::unexpected_value:
+      return "flag: " + token_ + " does not expect an argument.";
+    case error_code::too_many_values:
+      return "flag: " + token_ + " expects only one argument.";
+    case error_code::missing_value:
+      return "flag: " + token_ + " expects an argument.";
+    case error_code::missing_required:
+      return "required arg missing: " + detail_;
+    case error_code::invalid_value:
+      return (detail_.empty() ? "" : detail_ + ": ") + "invalid value: " +
+             token_;
+    case error_code::cannot_open_file:
+      return "cannot open file: " + token_;
+    case error_code::cannot_read_file:
+      return "cannot read file: " + token_;
+    case error_code::invalid_snapshot:
+      return "invalid snapshot: " + detail_;
+    case error_code::constraint_violation:
+      return command + detail_;
+    case error_code::invalid_path:
+      return "invalid path: " + detail_;
+    case error_code::cannot_load_plugin:
+      return "cannot load plugin: " + token_ +
+             (detail_.empty() ? "" : ": " + detail_);
+    case error_code::limit_exceeded:
+      return "limit exceeded: " + detail_ +
+             (token_.empty() ? "" : " (" + token_ + ")");
+    case error_code::custom:
+      return detail_;
+  }
+  return {};
+}
+
+std::string argument::get_flags() const {
+  std::string result = join(flags, ", ");
+  if (type != argument_type::none)
+    result += " " + metavar;
+  return result;
+}
+
+namespace {
+
+void show_help_col(const std::string &item, const std::string &help,
+                   int width, int total_width) {
+  auto txt = wahl::wrap(help, total_width - width - 2);
+  assert(!txt.empty());
+  std::cout << " " << std::setw(width) << item << " " << txt[0] << std::endl;
+  std::for_each(txt.begin() + 1, txt.end(), [&](std::string line) {
+    std::cout << " " << std::setw(width) << " "
+              << " " << line << std::endl;
+  });
+}
+
+} // namespace
+
+void context_base::show_help(const std::string &name,
+                             const std::string &description,
+                             const std::string &options_metavar) const {
+  const int total_width = 80;
+  auto subcommands = subcommand_list();
+  std::vector<std::string> flags;
+  int width = 0;
+  for (auto &&arg : arguments) {
+    std::string flag = arg.get_flags();
+    width = std::max(width, int(flag.size()));
+    flags.push_back(std::move(flag));
+  }
+  for (auto &&p : subcommands)
+    width = std::max(width, int(p.first.size()));
+  std::cout << "Usage: " << name << " " << options_metavar;
+
+  if (subcommands.size() > 0)
+    std::cout << " [command]";
+  if (lookup.count("") > 0)
+    std::cout << " " << (*this)[""].metavar;
+
+  std::cout << std::endl;
+  std::cout << std::endl;
+  for (auto line : wahl::wrap(description, total_width - 2))
+    std::cout << "  " << line << std::endl;
+  std::cout << std::endl;
+  std::cout << "Options: " << std::endl << std::endl;
+  // TODO: Switch to different format when width > 40
+  for (auto &&arg : arguments) {
+    auto help = arg.help;
+    if (not arg.default_description.empty())
+      help += (help.empty() ? "(default: " : " (default: ") +
+              arg.default_description + ")";
+    show_help_col(arg.get_flags(), help, width, total_width);
+  }
+  if (subcommands.size() > 0) {
+    std::cout << std::endl;
+    std::cout << "Commands: " << std::endl << std::endl;
+    for (auto &&p : subcommands) {
+      show_help_col(p.first, p.second, width, total_width);
+    }
+  }
+  std::cout << std::endl;
+}
+
+void print_help_matches(const std::vector<help_match> &matches) {
+  if (matches.empty()) {
+    std::cout << "No matches." << std::endl;
+    return;
+  }
+  const int total_width = 80;
+  std::vector<std::string> items;
+  int width = 0;
+  for (auto &&m : matches) {
+    auto item = m.document->command;
+    if (not m.document->flags.empty())
+      item += " " + m.document->flags;
+    width = std::max(width, int(item.size()));
+    items.push_back(std::move(item));
+  }
+  for (std::size_t i = 0; i < matches.size(); ++i)
+    show_help_col(items[i], matches[i].document->help, width, total_width);
+}
+
+} // namespace wahl
@@ -0,0 +1,46 @@
+// SPDX-License-Identifier: BSL-1.0
+
+#include <wahl/wahl.hpp>
+
+#include <mutex>
+#include <thread>
+
+namespace wahl {
+
+namespace {
+
+// Reloads are rare, so all writers share a single lock.
+std::mutex &writer_mutex() {
+  static std::mutex mutex;
+  return mutex;
+}
+
+} // namespace
+
+const void *reader_epochs::exchange(std::atomic<const void *> &current,
+                                    const void *next) {
+  std::lock_guard<std::mutex> lock(writer_mutex());
+  auto previous = current.exchange(next);
+  // A reader that saw `previous` entered an epoch before the exchange, but
+  // may have read the epoch long before it. Flipping the epoch twice and
+  // waiting for each side to drain covers both cases, while new readers
+  // move to the other side and cannot hold up the writer.
+  for (int i = 0; i < 2; ++i) {
+    auto epoch = epoch_.fetch_add(1) & 1u;
+    while (readers_[epoch].count.load(std::memory_order_acquire) != 0)
+      std::this_thread::yield();
+  }
+  return previous;
+}
+
+error read_arguments(const std::string &path,
+                     std::deque<std::string> &result) {
+  return wahl::for_each_line(path, [&](const std::string &line) {
+    auto first = line.find_first_not_of(" \t");
+    if (first != std::string::npos and line[first] != '#')
+      result.push_back(line.substr(first));
+    return true;
+  });
+}
+
+} // namespace wahl
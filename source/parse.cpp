@@ -0,0 +1,580 @@
+// SPDX-License-Identifier: BSL-1.0
+
+#include <wahl/wahl.hpp>
+
+#include <cctype>
+#include <cstring>
+#include <mutex>
+#include <numeric>
+
+namespace wahl {
+
+error &pending_error() noexcept {
+  static thread_local error e;
+  return e;
+}
+
+void fail(error e) {
+  auto &pending = pending_error();
+  if (not pending)
+    pending = std::move(e);
+}
+
+error take_pending_error() {
+  if (not pending_error())
+    return {};
+  return std::exchange(pending_error(), error{});
+}
+
+std::size_t allocation_counters::parse_allocations() const {
+  return std::accumulate(allocations.begin() + 1, allocations.end(),
+                         std::size_t{0});
+}
+
+std::size_t allocation_counters::parse_bytes() const {
+  return std::accumulate(bytes.begin() + 1, bytes.end(), std::size_t{0});
+}
+
+parse_phase &current_parse_phase() noexcept {
+  static thread_local parse_phase phase = parse_phase::none;
+  return phase;
+}
+
+allocation_counters &allocation_stats() noexcept {
+  static thread_local allocation_counters counters;
+  return counters;
+}
+
+void reset_allocation_stats() noexcept {
+  allocation_stats() = allocation_counters{};
+}
+
+void record_allocation(std::size_t size) noexcept {
+  auto phase = static_cast<std::size_t>(current_parse_phase());
+  auto &counters = allocation_stats();
+  ++counters.allocations[phase];
+  counters.bytes[phase] += size;
+}
+
+namespace {
+
+struct limit_state {
+  const limits *active = nullptr;
+  // The number of subcommands the current parse dispatched into.
+  std::size_t depth = 0;
+  // The bytes charged against the memory budget.
+  std::size_t used = 0;
+};
+
+limit_state &current_limits() noexcept {
+  static thread_local limit_state state;
+  return state;
+}
+
+error limit_exceeded(std::string token, std::size_t limit, const char *what) {
+  return {error_code::limit_exceeded, std::move(token),
+          "more than " + std::to_string(limit) + " " + what};
+}
+
+} // namespace
+
+limit_scope::limit_scope(const limits &l) noexcept
+    : limits_(l),
+      previous_limits_(current_limits().active),
+      previous_depth_(current_limits().depth),
+      previous_used_(current_limits().used) {
+  current_limits() = {&limits_, 0, 0};
+}
+
+limit_scope::~limit_scope() {
+  current_limits() = {previous_limits_, previous_depth_, previous_used_};
+}
+
+const limits *active_limits() noexcept { return current_limits().active; }
+
+error charge_memory(std::size_t bytes) {
+  auto &state = current_limits();
+  if (state.active == nullptr or state.active->memory_budget == 0)
+    return {};
+  state.used += bytes;
+  if (state.used > state.active->memory_budget)
+    return limit_exceeded({}, state.active->memory_budget,
+                          "bytes of memory");
+  return {};
+}
+
+error check_limits(const token_list &tokens) {
+  auto l = active_limits();
+  if (l == nullptr)
+    return {};
+  auto n = tokens.size();
+  if (l->max_tokens != 0 and n > l->max_tokens)
+    return limit_exceeded({}, l->max_tokens, "tokens")
+        .at(int(l->max_tokens));
+  std::size_t bytes = 0;
+  for (std::size_t i = 0; i < n; ++i) {
+    auto x = tokens.view(i);
+    // Only a prefix of an oversized token makes it into the error.
+    if (l->max_token_length != 0 and x.size() > l->max_token_length)
+      return limit_exceeded(std::string(x.substr(0, 32)) + "...",
+                            l->max_token_length, "bytes in a token")
+          .at(int(i));
+    bytes += x.size();
+    if (l->max_bytes != 0 and bytes > l->max_bytes)
+      return limit_exceeded({}, l->max_bytes, "bytes of arguments")
+          .at(int(i));
+  }
+  return charge_memory(n * sizeof(token));
+}
+
+void context_base::enable_abbreviations() {
+  abbreviations = true;
+  for (auto &&p : lookup)
+    if (p.first.size() > 2 and p.first.compare(0, 2, "--") == 0)
+      flag_index.insert(std::string(p.first), p.second);
+  if (not subcommand_index) {
+    auto index = std::make_shared<prefix_trie>();
+    int i = 0;
+    for (auto &&p : subcommand_list())
+      index->insert(p.first, i++);
+    subcommand_index = std::move(index);
+  }
+}
+
+std::shared_ptr<const void>
+registry_cache(const void *key, std::size_t generation,
+               const std::function<std::shared_ptr<const void>()> &build) {
+  struct entry {
+    std::size_t generation;
+    std::shared_ptr<const void> value;
+  };
+  static std::mutex mutex;
+  static std::map<const void *, entry, std::less<>> entries;
+  std::lock_guard<std::mutex> lock(mutex);
+  auto &x = entries[key];
+  if (not x.value or x.generation != generation)
+    x = {generation, build()};
+  return x.value;
+}
+
+error context_base::resolve_abbreviation(const prefix_trie &index,
+                                         std::string &x,
+                                         error_code ambiguous) const {
+  auto id = index.find(x);
+  if (id == prefix_trie::ambiguous)
+    return error{ambiguous, x, join(index.candidates(x), ", ")}.in(name);
+  if (id != prefix_trie::none)
+    x = index.key(id);
+  return {};
+}
+
+int context_base::flag_id(std::string_view flag,
+                          std::string_view *key) const {
+  auto it = lookup.find(flag);
+  if (it != lookup.end())
+    return it->second;
+  if (not abbreviations or flag.compare(0, 2, "--") != 0)
+    return -1;
+  auto id = flag_index.find(flag);
+  if (id == prefix_trie::ambiguous)
+    return -2;
+  if (id == prefix_trie::none)
+    return -1;
+  if (key != nullptr)
+    *key = flag_index.key(id);
+  return flag_index.value(id);
+}
+
+error context_base::ambiguous_flag(std::string_view flag) const {
+  return error{error_code::ambiguous_flag, std::string(flag),
+               join(flag_index.candidates(flag), ", ")}
+      .in(name);
+}
+
+error context_base::resolve_subcommand(const std::string &x,
+                                       std::string &name) const {
+  if (not abbreviations or not subcommand_index or x.empty() or x[0] == '-')
+    return {};
+  auto candidate = x;
+  if (auto e = resolve_abbreviation(*subcommand_index, candidate,
+                                    error_code::ambiguous_command))
+    return e;
+  if (has_subcommand(candidate))
+    name = std::move(candidate);
+  return {};
+}
+
+void context_base::add(argument arg) {
+  int id = int(arguments.size());
+  if (arg.flags.empty())
+    positional = id;
+  argument_slot slot;
+  slot.type = arg.type;
+  slot.eager = not arg.eager_callbacks.empty();
+  slot.deferred = arg.write_values and not slot.eager;
+  slot.write_value = std::move(arg.write_value);
+  slots.push_back(std::move(slot));
+  arguments.emplace_back(std::move(arg));
+  // The keys view the flags of the stored argument. Growing `arguments` moves
+  // the flag vectors, which keeps their strings in place.
+  static_assert(std::is_nothrow_move_constructible<argument>(),
+                "growing the arguments must not copy their flags");
+  if (positional == id)
+    lookup.insert_or_assign(std::string_view(), id);
+  for (auto &&flag : arguments.back().flags)
+    lookup.insert_or_assign(std::string_view(flag), id);
+}
+
+argument *context_base::find(std::string_view flag) {
+  auto it = lookup.find(flag);
+  return it == lookup.end() ? nullptr : &arguments[it->second];
+}
+
+error context_base::unknown_flag(const std::string &flag) const {
+  return error{error_code::unknown_flag, flag}.in(name);
+}
+
+argument &context_base::operator[](const std::string &flag) {
+  auto it = lookup.find(flag);
+  if (it == lookup.end())
+    wahl::raise(unknown_flag(flag));
+  return arguments[it->second];
+}
+
+const argument &context_base::operator[](const std::string &flag) const {
+  auto it = lookup.find(flag);
+  if (it == lookup.end())
+    wahl::raise(unknown_flag(flag));
+  return arguments[it->second];
+}
+
+error context_base::post_process() {
+  if (auto e = check_constraints())
+    return e;
+  phase_scope scope{parse_phase::callback};
+  for (auto &&arg : arguments) {
+    for (auto &&f : arg.callbacks)
+      f(arg);
+    if (pending_error())
+      return take_pending_error();
+  }
+  return {};
+}
+
+std::tuple<std::string, std::string>
+parse_attached_value(const std::string &s) {
+  assert(s.size() > 0);
+  assert(s[0] == '-' && "Not parsing a flag");
+  if (s[1] == '-') {
+    auto i = s.find('=');
+    if (i == std::string::npos)
+      return std::make_tuple(s, std::string());
+    return std::make_tuple(s.substr(0, i), s.substr(i + 1));
+  } else if (s.size() > 2) {
+    return std::make_tuple(s.substr(0, 2), s.substr(2));
+  } else {
+    return std::make_tuple(s, std::string());
+  }
+}
+
+namespace {
+
+// Converts the values that parallel() arguments collected while scanning.
+error convert_deferred(context_base &ctx, const token_list &tokens) {
+  phase_scope scope{parse_phase::value_write};
+  std::vector<std::string_view> values;
+  for (std::size_t i = 0; i < ctx.slots.size(); ++i) {
+    if (not ctx.slots[i].deferred)
+      continue;
+    auto &arg = ctx.arguments[i];
+    if (arg.deferred.empty())
+      continue;
+    values.clear();
+    values.reserve(arg.deferred.size());
+    for (auto &&p : arg.deferred)
+      values.push_back(tokens.view(p.first).substr(p.second));
+    auto invalid = arg.write_values(values);
+    if (invalid >= 0)
+      return error{error_code::invalid_value, std::string(values[invalid])}
+          .at(arg.deferred[invalid].first);
+    arg.deferred.clear();
+  }
+  return {};
+}
+
+// Writes a value to the argument with index `id`, and runs its eager
+// callbacks. Returns true if parsing should stop, either because of an eager
+// callback or an error.
+bool write_argument(context_base &ctx, int id, const std::string &s) {
+  auto &slot = ctx.slots[id];
+  {
+    phase_scope scope{parse_phase::value_write};
+    slot.write_value(s);
+  }
+  if (pending_error())
+    return true;
+  slot.count++;
+  if (not slot.eager)
+    return false;
+  auto &arg = ctx.arguments[id];
+  arg.count = slot.count;
+  phase_scope scope{parse_phase::callback};
+  for (auto &&f : arg.eager_callbacks)
+    f(arg);
+  return true;
+}
+
+} // namespace
+
+void tokenize(const context_base &ctx, const token_list &tokens,
+              std::vector<token> &result) {
+  result.clear();
+  result.reserve(tokens.size());
+  std::string buffer;
+  std::size_t i = 0;
+  for (; i < tokens.size(); ++i) {
+    auto x = tokens.view(i);
+    if (ctx.has_subcommand(tokens.get(i, buffer))) {
+      result.push_back({token_kind::subcommand, -1, i, x, {}});
+      return;
+    }
+    if (x.empty() or x[0] != '-') {
+      result.push_back({token_kind::value, -1, i, x, {}});
+      continue;
+    }
+    if (x == "--") {
+      result.push_back({token_kind::terminator, -1, i, x, {}});
+      break;
+    }
+    // Splits the flag from an attached value.
+    auto flag = x;
+    std::string_view value;
+    if (x.size() > 1 and x[1] == '-') {
+      auto eq = static_cast<const char *>(
+          std::memchr(x.data(), '=', x.size()));
+      if (eq != nullptr) {
+        flag = x.substr(0, eq - x.data());
+        value = x.substr(eq - x.data() + 1);
+      }
+    } else if (x.size() > 2) {
+      flag = x.substr(0, 2);
+      value = x.substr(2);
+    }
+    auto id = ctx.flag_id(flag, &flag);
+    if (id < 0) {
+      auto kind = id == -2 ? token_kind::ambiguous : token_kind::unknown;
+      result.push_back({kind, -1, i, flag, value});
+      continue;
+    }
+    result.push_back({token_kind::flag, id, i, flag, value});
+    // Characters after a flag without a value are more flags.
+    if (ctx.slots[id].type == argument_type::none) {
+      for (std::size_t j = 0; j < value.size(); ++j) {
+        const char bundled[] = {'-', value[j]};
+        auto other = ctx.flag_id({bundled, 2});
+        result.push_back({token_kind::bundled, other < 0 ? -1 : other, i,
+                          value.substr(j, 1), {}});
+      }
+    }
+  }
+  for (++i; i < tokens.size(); ++i)
+    result.push_back({token_kind::value, -1, i, tokens.view(i), {}});
+}
+
+namespace {
+
+error scan_tokens(context_base &ctx, const token_list &tokens,
+                  scan_handler &handler, bool &completed) {
+  phase_scope scope{parse_phase::tokenization};
+  if (auto e = check_limits(tokens))
+    return e;
+  std::vector<token> stream;
+  wahl::tokenize(ctx, tokens, stream);
+  std::size_t i = 0;
+  auto index = [&] { return int(i); };
+  auto &limited = current_limits();
+  auto dispatch = [&](const std::string &name) {
+    completed = false;
+    if (auto e = convert_deferred(ctx, tokens))
+      return e;
+    if (limited.active != nullptr and limited.active->max_depth != 0 and
+        limited.depth + 1 >= limited.active->max_depth)
+      return limit_exceeded(name, limited.active->max_depth,
+                            "nested commands")
+          .at(index());
+    ++limited.depth;
+    auto e = handler.dispatch(name, i);
+    --limited.depth;
+    return e;
+  };
+  // Stops after an eager callback, or reports an error from a writer.
+  auto stop = [&] {
+    completed = false;
+    return take_pending_error().at(index()).in(ctx.name);
+  };
+  std::string buffer;
+  // Charges a value of an argument against the active limits, including the
+  // empty values of flags without a value, bundled or not.
+  auto charge = [&](int id, std::string_view value) {
+    if (limited.active == nullptr)
+      return false;
+    auto max = limited.active->max_values;
+    auto e = max != 0 and std::size_t(ctx.slots[id].count) >= max
+                 ? limit_exceeded(ctx.arguments[id].get_flags(), max,
+                                  "values")
+                 : charge_memory(value.size() + sizeof(std::string));
+    if (e)
+      fail(std::move(e));
+    return bool(e);
+  };
+  // Writes a flag without a value.
+  auto set = [&](int id) {
+    return charge(id, {}) or write_argument(ctx, id, "");
+  };
+  // Writes the value of a token. Whole arguments are passed on without a
+  // copy if the caller stores them as strings.
+  auto write = [&](int id, const token &t) {
+    auto &slot = ctx.slots[id];
+    if (charge(id, t.kind == token_kind::value ? t.text : t.value))
+      return true;
+    auto offset = std::size_t(t.kind == token_kind::value
+                                  ? 0
+                                  : t.value.data() - tokens.view(i).data());
+    if (slot.deferred) {
+      ctx.arguments[id].deferred.emplace_back(index(), offset);
+      slot.count++;
+      return false;
+    }
+    if (t.kind == token_kind::value)
+      return write_argument(ctx, id, tokens.get(i, buffer));
+    buffer.assign(t.value);
+    return write_argument(ctx, id, buffer);
+  };
+  completed = true;
+  bool capture = false;
+  // Whether the next value is the first value of the last flag.
+  bool awaiting = false;
+  // The last flag, for errors about values that follow it.
+  const token *last = nullptr;
+  int arg = -1;
+  for (auto it = stream.begin(); it != stream.end(); ++it) {
+    const auto &t = *it;
+    i = t.index;
+    switch (t.kind) {
+      case token_kind::subcommand:
+        return dispatch(tokens.get(i, buffer));
+      case token_kind::terminator:
+        if (handler.terminate(i))
+          return convert_deferred(ctx, tokens);
+        for (++it; it != stream.end(); ++it) {
+          i = it->index;
+          if (ctx.positional < 0)
+            return error{error_code::unknown_command, tokens.get(i, buffer)}
+                .at(index());
+          if (write(ctx.positional, *it))
+            return stop();
+        }
+        return convert_deferred(ctx, tokens);
+      case token_kind::ambiguous:
+        return ctx.ambiguous_flag(t.text).at(index());
+      case token_kind::unknown:
+        capture = false;
+        awaiting = false;
+        if (handler.unknown(i)) {
+          last = nullptr;
+          continue;
+        }
+        return ctx.unknown_flag(std::string(t.text)).at(index());
+      case token_kind::bundled:
+        if (t.argument < 0)
+          return ctx.unknown_flag("-" + std::string(t.text)).at(index());
+        if (set(t.argument))
+          return stop();
+        continue;
+      case token_kind::flag:
+        capture = false;
+        last = &t;
+        arg = t.argument;
+        if (ctx.slots[arg].type == argument_type::none) {
+          if (set(arg))
+            return stop();
+        } else if (not t.value.empty()) {
+          if (write(arg, t))
+            return stop();
+        } else {
+          capture = true;
+          awaiting = true;
+        }
+        continue;
+      case token_kind::value:
+        break;
+    }
+    if (not awaiting and handler.separates(i))
+      return convert_deferred(ctx, tokens);
+    awaiting = false;
+    if (capture) {
+      if (write(arg, t))
+        return stop();
+      capture = ctx.slots[arg].type == argument_type::multiple;
+    } else if (ctx.positional >= 0) {
+      if (write(ctx.positional, t))
+        return stop();
+    } else {
+      const auto &x = tokens.get(i, buffer);
+      std::string sub;
+      if (auto e = ctx.resolve_subcommand(x, sub))
+        return e.at(index());
+      if (not sub.empty())
+        return dispatch(sub);
+      if (handler.unknown(i))
+        continue;
+      if (last == nullptr)
+        return error{error_code::unknown_command, x}.at(index());
+      if (ctx.slots[arg].type == argument_type::none)
+        return error{error_code::unexpected_value, std::string(last->text)}
+            .at(index());
+      if (ctx.slots[arg].type != argument_type::multiple)
+        return error{error_code::too_many_values, std::string(last->text)}
+            .at(index());
+    }
+  }
+  return convert_deferred(ctx, tokens);
+}
+
+} // namespace
+
+error scan_arguments(context_base &ctx, const token_list &tokens,
+                     scan_handler &handler, bool &completed) {
+  if (ctx.declaration_error)
+    return ctx.declaration_error;
+  auto e = scan_tokens(ctx, tokens, handler, completed);
+  // Callbacks, constraints, and callers read the counts from the arguments.
+  for (std::size_t i = 0; i < ctx.slots.size(); ++i)
+    ctx.arguments[i].count = ctx.slots[i].count;
+  return e;
+}
+
+std::string_view program_name(const char *argv0) {
+  std::string_view result = argv0;
+#if defined(_WIN32)
+  auto slash = result.find_last_of("/\\");
+#else
+  auto slash = result.find_last_of('/');
+#endif
+  if (slash != std::string_view::npos)
+    result.remove_prefix(slash + 1);
+#if defined(_WIN32)
+  constexpr std::string_view suffix = ".exe";
+  if (result.size() > suffix.size()) {
+    auto tail = result.substr(result.size() - suffix.size());
+    if (std::equal(tail.begin(), tail.end(), suffix.begin(),
+                   [](char x, char y) {
+                     return std::tolower(static_cast<unsigned char>(x)) == y;
+                   }))
+      result.remove_suffix(suffix.size());
+  }
+#endif
+  return result;
+}
+
+} // namespace wahl
@@ -0,0 +1,80 @@
+// SPDX-License-Identifier: BSL-1.0
+
+#include <wahl/wahl.hpp>
+
+#include <filesystem>
+
+#if defined(_WIN32)
+#  include <io.h>
+#else
+#  include <unistd.h>
+#endif
+
+namespace wahl {
+
+namespace {
+
+// Path checks mostly wait for the file system, e.g., on network mounts, so
+// they run on more threads than there are cores.
+constexpr unsigned path_check_threads = 16;
+
+bool accessible(const std::string &path, bool write) {
+#if defined(_WIN32)
+  return ::_access(path.c_str(), write ? 2 : 4) == 0;
+#else
+  return ::access(path.c_str(), write ? W_OK : R_OK) == 0;
+#endif
+}
+
+// Returns why `path` fails the check, or null if it passes.
+const char *check_path(path_check check, const std::string &path) {
+  namespace fs = std::filesystem;
+  std::error_code ec;
+  auto status = fs::status(path, ec);
+  if (not fs::exists(status))
+    return "does not exist";
+  switch (check) {
+    case path_check::existing_file:
+      return fs::is_directory(status) ? "is a directory" : nullptr;
+    case path_check::existing_dir:
+      return fs::is_directory(status) ? nullptr : "is not a directory";
+    case path_check::readable:
+      return accessible(path, false) ? nullptr : "is not readable";
+    case path_check::writable_dir:
+      if (not fs::is_directory(status))
+        return "is not a directory";
+      return accessible(path, true) ? nullptr : "is not writable";
+  }
+  return nullptr;
+}
+
+} // namespace
+
+error check_paths(path_check check, const std::vector<std::string> &paths,
+                  const std::string &flags) {
+  std::vector<const char *> failures(paths.size());
+  auto check_one = [&](std::size_t i) {
+    failures[i] = check_path(check, paths[i]);
+  };
+  if (paths.size() < 2) {
+    for (std::size_t i = 0; i < paths.size(); ++i)
+      check_one(i);
+  } else {
+    static thread_pool pool(path_check_threads);
+    pool.run(paths.size(), check_one);
+  }
+  const std::string *first = nullptr;
+  std::string detail;
+  for (std::size_t i = 0; i < paths.size(); ++i) {
+    if (failures[i] == nullptr)
+      continue;
+    if (first == nullptr)
+      first = &paths[i];
+    detail += (detail.empty() ? "" : "; ") + paths[i] + " " + failures[i];
+  }
+  if (first == nullptr)
+    return {};
+  return {error_code::invalid_path, *first, flags + ": " + detail};
+}
+
+} // namespace wahl
@@ -0,0 +1,130 @@
+// SPDX-License-Identifier: BSL-1.0
+
+#include <wahl/wahl.hpp>
+
+#include <mutex>
+
+#if defined(_WIN32)
+#  include <windows.h>
+#else
+#  include <dlfcn.h>
+#endif
+
+namespace wahl {
+
+namespace {
+
+// Serializes loading, so that a library is opened once even if a group is
+// parsed from several threads.
+std::mutex &plugin_mutex() {
+  static std::mutex mutex;
+  return mutex;
+}
+
+#if defined(_WIN32)
+
+void *open_library(const std::string &path, std::string &detail) {
+  auto handle = ::LoadLibraryA(path.c_str());
+  if (handle == nullptr)
+    detail = "error " + std::to_string(::GetLastError());
+  return reinterpret_cast<void *>(handle);
+}
+
+void *find_symbol(void *handle, const std::string &symbol) {
+  return reinterpret_cast<void *>(
+      ::GetProcAddress(static_cast<HMODULE>(handle), symbol.c_str()));
+}
+
+#else
+
+void *open_library(const std::string &path, std::string &detail) {
+  // The command's symbols stay local to the library, so that plugins with
+  // the same internal names do not interfere with each other.
+  auto handle = ::dlopen(path.c_str(), RTLD_NOW | RTLD_LOCAL);
+  if (handle == nullptr)
+    if (auto message = ::dlerror())
+      detail = message;
+  return handle;
+}
+
+void *find_symbol(void *handle, const std::string &symbol) {
+  return ::dlsym(handle, symbol.c_str());
+}
+
+#endif
+
+} // namespace
+
+plugin::plugin(const std::string &name, std::string path, std::string symbol)
+    : path_(std::move(path)), symbol_(std::move(symbol)) {
+  if (symbol_.empty()) {
+    symbol_ = "wahl_plugin_" + name;
+    std::replace(symbol_.begin(), symbol_.end(), '-', '_');
+  }
+}
+
+bool plugin::loaded() const {
+  std::lock_guard<std::mutex> lock(plugin_mutex());
+  return entry_ != nullptr;
+}
+
+result plugin::run(const std::deque<std::string> &args, void *parent) const {
+  plugin_entry entry;
+  {
+    std::lock_guard<std::mutex> lock(plugin_mutex());
+    if (entry_ == nullptr) {
+      std::string detail;
+      auto handle = open_library(path_, detail);
+      if (handle == nullptr)
+        return error{error_code::cannot_load_plugin, path_, detail};
+      // Libraries are never closed: the command may leave behind objects
+      // whose code lives in the library.
+      auto symbol = find_symbol(handle, symbol_);
+      if (symbol == nullptr)
+        return error{error_code::cannot_load_plugin, path_,
+                     "missing symbol " + symbol_};
+      entry_ = reinterpret_cast<plugin_entry>(symbol);
+    }
+    entry = entry_;
+  }
+  result out;
+  entry(args, parent, out);
+  return out;
+}
+
+error read_plugin_manifest(const std::string &path,
+                           std::vector<plugin_manifest_entry> &result) {
+  auto slash = path.find_last_of("/\\");
+  auto directory = slash == std::string::npos ? std::string()
+                                              : path.substr(0, slash + 1);
+  std::size_t line_number = 0;
+  error failure;
+  auto e = wahl::for_each_line(path, [&](const std::string &line) {
+    ++line_number;
+    auto first = line.find_first_not_of(" \t");
+    if (first == std::string::npos or line[first] == '#')
+      return true;
+    auto name_end = line.find_first_of(" \t", first);
+    auto path_first = line.find_first_not_of(" \t", name_end);
+    if (path_first == std::string::npos) {
+      failure = {error_code::invalid_value, line,
+                 path + ":" + std::to_string(line_number)};
+      return false;
+    }
+    auto path_end = line.find_first_of(" \t", path_first);
+    auto help_first = line.find_first_not_of(" \t", path_end);
+    plugin_manifest_entry entry;
+    entry.name = line.substr(first, name_end - first);
+    entry.path = line.substr(path_first, path_end - path_first);
+    if (help_first != std::string::npos)
+      entry.help = line.substr(help_first);
+    if (entry.path.front() != '/' and entry.path.front() != '\\' and
+        not(entry.path.size() > 1 and entry.path[1] == ':'))
+      entry.path = directory + entry.path;
+    result.push_back(std::move(entry));
+    return true;
+  });
+  return e ? e : failure;
+}
+
+} // namespace wahl
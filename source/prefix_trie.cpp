@@ -0,0 +1,85 @@
+// SPDX-License-Identifier: BSL-1.0
+
+#include <wahl/wahl.hpp>
+
+namespace wahl {
+
+void prefix_trie::insert(std::string key, int value) {
+  int id = int(keys.size());
+  int n = root();
+  mark(n, id, value);
+  for (char c : key) {
+    n = add_child(n, c);
+    mark(n, id, value);
+  }
+  if (nodes[n].key < 0)
+    nodes[n].key = id;
+  keys.push_back(std::move(key));
+  values.push_back(value);
+}
+
+int prefix_trie::find(std::string_view prefix) const {
+  if (nodes.empty())
+    return none;
+  int n = 0;
+  for (char c : prefix) {
+    n = find_child(n, c);
+    if (n < 0)
+      return none;
+  }
+  if (nodes[n].key >= 0)
+    return nodes[n].key;
+  return nodes[n].unique;
+}
+
+std::vector<std::string>
+prefix_trie::candidates(std::string_view prefix) const {
+  std::map<int, std::string> best;
+  for (std::size_t i = 0; i < keys.size(); ++i) {
+    if (keys[i].compare(0, prefix.size(), prefix) != 0)
+      continue;
+    auto &x = best[values[i]];
+    if (x.empty() or keys[i].size() < x.size() or
+        (keys[i].size() == x.size() and keys[i] < x))
+      x = keys[i];
+  }
+  std::vector<std::string> result;
+  for (auto &&p : best)
+    result.push_back(p.second);
+  std::sort(result.begin(), result.end());
+  return result;
+}
+
+int prefix_trie::root() {
+  if (nodes.empty())
+    nodes.push_back(node{'\0'});
+  return 0;
+}
+
+int prefix_trie::find_child(int n, char c) const {
+  for (int i = nodes[n].child; i >= 0; i = nodes[i].sibling)
+    if (nodes[i].c == c)
+      return i;
+  return -1;
+}
+
+int prefix_trie::add_child(int n, char c) {
+  auto i = find_child(n, c);
+  if (i >= 0)
+    return i;
+  node x{c};
+  x.sibling = nodes[n].child;
+  nodes.push_back(x);
+  nodes[n].child = int(nodes.size() - 1);
+  return nodes[n].child;
+}
+
+void prefix_trie::mark(int n, int id, int value) {
+  auto &unique = nodes[n].unique;
+  if (unique == none)
+    unique = id;
+  else if (unique >= 0 and values[unique] != value)
+    unique = ambiguous;
+}
+
+} // namespace wahl
@@ -0,0 +1,129 @@
+// SPDX-License-Identifier: BSL-1.0
+
+#include <wahl/wahl.hpp>
+
+#include <cctype>
+#include <cmath>
+
+namespace wahl {
+
+namespace {
+
+// Calls f(word) for every run of letters and digits in `s`, in lowercase.
+template <class F> void for_each_word(std::string_view s, F f) {
+  std::string word;
+  for (auto c : s) {
+    auto x = static_cast<unsigned char>(c);
+    if (std::isalnum(x)) {
+      word += char(std::tolower(x));
+    } else if (not word.empty()) {
+      f(word);
+      word.clear();
+    }
+  }
+  if (not word.empty())
+    f(word);
+}
+
+// The weight of a word by where it occurs in a document.
+constexpr double command_weight = 4;
+constexpr double flag_weight = 2;
+constexpr double help_weight = 1;
+// Words in the command of a flag's document only narrow the search.
+constexpr double context_weight = 0.5;
+// A prefix matches a longer word with less weight than the whole word.
+constexpr double prefix_weight = 0.5;
+
+} // namespace
+
+flag_help_list list_flag_help(const context_base &ctx, std::size_t first) {
+  flag_help_list result;
+  for (auto i = first; i < ctx.arguments.size(); ++i) {
+    auto &arg = ctx.arguments[i];
+    if (not arg.flags.empty())
+      result.emplace_back(join(arg.flags, ", "), arg.help);
+  }
+  return result;
+}
+
+void help_index::add(help_document document) {
+  std::map<std::string, double, std::less<>> weights;
+  auto weigh = [&](double weight) {
+    return [&weights, weight](const std::string &word) {
+      weights[word] += weight;
+    };
+  };
+  for_each_word(document.command, weigh(document.flags.empty()
+                                            ? command_weight
+                                            : context_weight));
+  for_each_word(document.flags, weigh(flag_weight));
+  for_each_word(document.help, weigh(help_weight));
+  auto id = int(documents_.size());
+  for (auto &&p : weights)
+    postings_[p.first].push_back({id, p.second});
+  documents_.push_back(std::move(document));
+}
+
+std::vector<help_match> help_index::search(std::string_view terms,
+                                           std::size_t limit) const {
+  std::vector<std::string> words;
+  for_each_word(terms, [&](const std::string &word) {
+    if (std::find(words.begin(), words.end(), word) == words.end())
+      words.push_back(word);
+  });
+  if (words.empty() or limit == 0)
+    return {};
+  auto n = documents_.size();
+  std::vector<double> scores(n);
+  // How many of the words a document contains, counting every word once.
+  std::vector<std::size_t> hits(n), last(n, words.size());
+  for (std::size_t k = 0; k < words.size(); ++k) {
+    auto &word = words[k];
+    for (auto it = postings_.lower_bound(word);
+         it != postings_.end() and it->first.compare(0, word.size(), word) == 0;
+         ++it) {
+      // Words that occur in fewer documents say more about a match.
+      auto rarity = std::log(1.0 + double(n) / double(it->second.size()));
+      if (it->first.size() != word.size())
+        rarity *= prefix_weight;
+      for (auto &&p : it->second) {
+        scores[p.document] += p.weight * rarity;
+        if (last[p.document] != k) {
+          last[p.document] = k;
+          ++hits[p.document];
+        }
+      }
+    }
+  }
+  std::vector<help_match> result;
+  for (std::size_t i = 0; i < n; ++i)
+    if (hits[i] == words.size())
+      result.push_back({&documents_[i], scores[i]});
+  auto better = [](const help_match &x, const help_match &y) {
+    if (x.score != y.score)
+      return x.score > y.score;
+    return x.document < y.document;
+  };
+  if (result.size() > limit) {
+    std::partial_sort(result.begin(), result.begin() + limit, result.end(),
+                      better);
+    result.resize(limit);
+  } else {
+    std::sort(result.begin(), result.end(), better);
+  }
+  return result;
+}
+
+void help_search::run() {
+  if (terms.empty()) {
+    std::vector<help_match> commands;
+    for (auto &&x : index->documents())
+      if (x.flags.empty())
+        commands.push_back({&x, 0});
+    wahl::print_help_matches(commands);
+    return;
+  }
+  wahl::print_help_matches(index->search(join(terms, " "), limit));
+}
+
+} // namespace wahl
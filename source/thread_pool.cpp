@@ -0,0 +1,107 @@
+// SPDX-License-Identifier: BSL-1.0
+
+#include <wahl/wahl.hpp>
+
+#include <condition_variable>
+#include <mutex>
+#include <thread>
+
+namespace wahl {
+
+struct thread_pool::state {
+  std::mutex batch_mutex;
+  std::mutex mutex;
+  std::condition_variable ready;
+  std::condition_variable done;
+  void (*task)(void *, std::size_t) = nullptr;
+  void *f = nullptr;
+  std::size_t next = 0;
+  std::size_t total = 0;
+  std::size_t unfinished = 0;
+  bool stopping = false;
+  std::vector<std::thread> workers;
+
+  // Runs the next task of the batch with `lock` released.
+  void execute(std::unique_lock<std::mutex> &lock) {
+    auto i = next++;
+    lock.unlock();
+    task(f, i);
+    lock.lock();
+    if (--unfinished == 0)
+      done.notify_all();
+  }
+
+  void work();
+};
+
+namespace {
+
+bool &inside_task() noexcept {
+  static thread_local bool inside = false;
+  return inside;
+}
+
+} // namespace
+
+void thread_pool::state::work() {
+  inside_task() = true;
+  std::unique_lock<std::mutex> lock(mutex);
+  for (;;) {
+    ready.wait(lock, [this] { return stopping or next < total; });
+    if (stopping)
+      return;
+    execute(lock);
+  }
+}
+
+thread_pool::thread_pool(unsigned threads) : state_(std::make_unique<state>()) {
+  if (threads == 0)
+    threads = std::max(1u, std::thread::hardware_concurrency());
+  for (unsigned i = 1; i < threads; ++i)
+    state_->workers.emplace_back([s = state_.get()] { s->work(); });
+}
+
+thread_pool::~thread_pool() {
+  {
+    std::lock_guard<std::mutex> lock(state_->mutex);
+    state_->stopping = true;
+  }
+  state_->ready.notify_all();
+  for (auto &&t : state_->workers)
+    t.join();
+}
+
+std::size_t thread_pool::size() const { return state_->workers.size() + 1; }
+
+thread_pool &thread_pool::shared() {
+  static thread_pool pool;
+  return pool;
+}
+
+void thread_pool::run_batch(std::size_t n, void (*task)(void *, std::size_t),
+                            void *f) {
+  auto &s = *state_;
+  if (s.workers.empty() or n < 2 or inside_task()) {
+    for (std::size_t i = 0; i < n; ++i)
+      task(f, i);
+    return;
+  }
+  std::lock_guard<std::mutex> batch(s.batch_mutex);
+  {
+    std::lock_guard<std::mutex> lock(s.mutex);
+    s.task = task;
+    s.f = f;
+    s.next = 0;
+    s.total = n;
+    s.unfinished = n;
+  }
+  s.ready.notify_all();
+  inside_task() = true;
+  std::unique_lock<std::mutex> lock(s.mutex);
+  while (s.next < s.total)
+    s.execute(lock);
+  s.done.wait(lock, [&s] { return s.unfinished == 0; });
+  inside_task() = false;
+}
+
+} // namespace wahl
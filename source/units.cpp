@@ -0,0 +1,229 @@
+// SPDX-License-Identifier: BSL-1.0
+
+#include <wahl/wahl.hpp>
+
+#include <numeric>
+
+namespace wahl {
+
+namespace {
+
+constexpr auto max_u64 = std::numeric_limits<std::uint64_t>::max();
+
+struct unit {
+  std::string_view suffix;
+  std::uint64_t scale;
+};
+
+constexpr std::uint64_t ns_per_second = 1000000000;
+
+constexpr unit duration_units[] = {
+    {"ns", 1},
+    {"us", 1000},
+    {"\xc2\xb5s", 1000}, // µs
+    {"ms", 1000000},
+    {"s", ns_per_second},
+    {"m", 60 * ns_per_second},
+    {"min", 60 * ns_per_second},
+    {"h", 3600 * ns_per_second},
+    {"d", 86400 * ns_per_second},
+};
+
+constexpr unit byte_units[] = {
+    {"", 1},
+    {"B", 1},
+    {"kB", 1000},
+    {"KB", 1000},
+    {"MB", 1000000},
+    {"GB", 1000000000},
+    {"TB", 1000000000000},
+    {"PB", 1000000000000000},
+    {"EB", 1000000000000000000},
+    {"KiB", std::uint64_t{1} << 10},
+    {"MiB", std::uint64_t{1} << 20},
+    {"GiB", std::uint64_t{1} << 30},
+    {"TiB", std::uint64_t{1} << 40},
+    {"PiB", std::uint64_t{1} << 50},
+    {"EiB", std::uint64_t{1} << 60},
+};
+
+constexpr unit quantity_units[] = {
+    {"", 1},
+    {"k", 1000},
+    {"K", 1000},
+    {"M", 1000000},
+    {"G", 1000000000},
+    {"T", 1000000000000},
+    {"P", 1000000000000000},
+    {"E", 1000000000000000000},
+};
+
+bool is_digit(char c) { return c >= '0' and c <= '9'; }
+
+// A decimal number as its integer part and up to 19 fractional digits.
+struct decimal {
+  std::uint64_t integer = 0;
+  std::uint64_t fraction = 0;
+  int fraction_digits = 0;
+};
+
+// Reads a decimal number at `i`, which must start with a digit.
+bool read_decimal(std::string_view x, std::size_t &i, decimal &result) {
+  if (i == x.size() or not is_digit(x[i]))
+    return false;
+  for (; i < x.size() and is_digit(x[i]); ++i) {
+    auto digit = static_cast<std::uint64_t>(x[i] - '0');
+    if (result.integer > (max_u64 - digit) / 10)
+      return false;
+    result.integer = result.integer * 10 + digit;
+  }
+  if (i == x.size() or x[i] != '.')
+    return true;
+  ++i;
+  if (i == x.size() or not is_digit(x[i]))
+    return false;
+  for (; i < x.size() and is_digit(x[i]); ++i) {
+    if (result.fraction_digits == 19)
+      return false;
+    result.fraction = result.fraction * 10 + (x[i] - '0');
+    ++result.fraction_digits;
+  }
+  return true;
+}
+
+// Reads the unit at `i`, which extends up to the next digit, and looks it up
+// in `units`.
+template <std::size_t N>
+bool read_unit(std::string_view x, std::size_t &i, const unit (&units)[N],
+               std::uint64_t &scale) {
+  auto first = i;
+  while (i < x.size() and not is_digit(x[i]) and x[i] != '/')
+    ++i;
+  auto suffix = x.substr(first, i - first);
+  for (auto &&u : units) {
+    if (u.suffix == suffix) {
+      scale = u.scale;
+      return true;
+    }
+  }
+  return false;
+}
+
+// Multiplies a decimal number with `scale`, and rejects results that are not
+// whole numbers or do not fit.
+bool scale_decimal(const decimal &d, std::uint64_t scale,
+                   std::uint64_t &result) {
+  if (d.integer != 0 and scale > max_u64 / d.integer)
+    return false;
+  result = d.integer * scale;
+  auto fraction = d.fraction;
+  auto digits = d.fraction_digits;
+  for (; digits > 0 and fraction % 10 == 0; --digits)
+    fraction /= 10;
+  if (fraction == 0)
+    return true;
+  std::uint64_t power = 1;
+  for (int j = 0; j < digits; ++j)
+    power *= 10;
+  // The fractional part is fraction * scale / power, which is a whole number
+  // if the reduced denominator divides the fraction. It is smaller than
+  // `scale`, so computing it this way cannot overflow.
+  auto divisor = power / std::gcd(scale, power);
+  if (fraction % divisor != 0)
+    return false;
+  auto part = fraction / divisor * (scale / (power / divisor));
+  if (result > max_u64 - part)
+    return false;
+  result += part;
+  return true;
+}
+
+// Parses a number with an optional unit from `units` at `i`.
+template <std::size_t N>
+bool read_scaled(std::string_view x, std::size_t &i, const unit (&units)[N],
+                 std::uint64_t &result) {
+  decimal d;
+  std::uint64_t scale = 0;
+  return read_decimal(x, i, d) and read_unit(x, i, units, scale) and
+         scale_decimal(d, scale, result);
+}
+
+// Parses one or more durations with units, as in "1h30m", at `i`.
+bool read_duration(std::string_view x, std::size_t &i, std::uint64_t &total) {
+  total = 0;
+  do {
+    std::uint64_t part = 0;
+    if (not read_scaled(x, i, duration_units, part) or part > max_u64 - total)
+      return false;
+    total += part;
+  } while (i < x.size() and x[i] != '/');
+  return true;
+}
+
+} // namespace
+
+bool parse_duration(std::string_view x, std::int64_t &nanoseconds) {
+  bool negative = not x.empty() and x[0] == '-';
+  std::size_t i = negative or (not x.empty() and x[0] == '+') ? 1 : 0;
+  std::uint64_t total = 0;
+  // A plain zero needs no unit.
+  if (x.substr(i) == "0") {
+    nanoseconds = 0;
+    return true;
+  }
+  if (not read_duration(x, i, total) or i != x.size())
+    return false;
+  constexpr auto max = std::numeric_limits<std::int64_t>::max();
+  if (total > static_cast<std::uint64_t>(max))
+    return false;
+  nanoseconds = negative ? -static_cast<std::int64_t>(total)
+                         : static_cast<std::int64_t>(total);
+  return true;
+}
+
+bool parse_byte_size(std::string_view x, std::uint64_t &bytes) {
+  std::size_t i = 0;
+  std::uint64_t result = 0;
+  if (not read_scaled(x, i, byte_units, result) or i != x.size())
+    return false;
+  bytes = result;
+  return true;
+}
+
+bool parse_quantity(std::string_view x, std::uint64_t &value) {
+  std::size_t i = 0;
+  std::uint64_t result = 0;
+  if (not read_scaled(x, i, quantity_units, result) or i != x.size())
+    return false;
+  value = result;
+  return true;
+}
+
+bool parse_rate(std::string_view x, std::uint64_t &count,
+                std::int64_t &period_nanoseconds) {
+  std::size_t i = 0;
+  std::uint64_t n = 0;
+  if (not read_scaled(x, i, quantity_units, n))
+    return false;
+  std::uint64_t period = ns_per_second;
+  if (i < x.size()) {
+    if (x[i] != '/' or ++i == x.size())
+      return false;
+    // A period without a number, as in "10k/s", is a single unit.
+    if (not is_digit(x[i])) {
+      if (not read_unit(x, i, duration_units, period))
+        return false;
+    } else if (not read_duration(x, i, period)) {
+      return false;
+    }
+    if (i != x.size() or period == 0 or
+        period > static_cast<std::uint64_t>(
+                     std::numeric_limits<std::int64_t>::max()))
+      return false;
+  }
+  count = n;
+  period_nanoseconds = static_cast<std::int64_t>(period);
+  return true;
+}
+
+} // namespace wahl
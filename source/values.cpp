@@ -0,0 +1,101 @@
+// SPDX-License-Identifier: BSL-1.0
+
+#include <wahl/wahl.hpp>
+
+#include <cstdio>
+#include <cstring>
+#include <sstream>
+
+namespace wahl {
+
+namespace {
+
+template <class T> bool read_value(const std::string &x, T &result) {
+  std::istringstream ss(x);
+  ss >> result;
+  return not ss.fail();
+}
+
+} // namespace
+
+bool read_from_stream(const std::string &x,
+                      void (*read)(std::istream &, void *), void *result) {
+  std::istringstream ss(x);
+  read(ss, result);
+  return not ss.fail();
+}
+
+#define WAHL_PARSE_VALUE(type)                                                 \
+  bool parse_value(const std::string &x, type &result) {                       \
+    return read_value(x, result);                                              \
+  }
+
+WAHL_PARSE_VALUE(bool)
+WAHL_PARSE_VALUE(char)
+WAHL_PARSE_VALUE(signed char)
+WAHL_PARSE_VALUE(unsigned char)
+WAHL_PARSE_VALUE(short)
+WAHL_PARSE_VALUE(unsigned short)
+WAHL_PARSE_VALUE(int)
+WAHL_PARSE_VALUE(unsigned int)
+WAHL_PARSE_VALUE(long)
+WAHL_PARSE_VALUE(unsigned long)
+WAHL_PARSE_VALUE(long long)
+WAHL_PARSE_VALUE(unsigned long long)
+WAHL_PARSE_VALUE(float)
+WAHL_PARSE_VALUE(double)
+WAHL_PARSE_VALUE(long double)
+
+#undef WAHL_PARSE_VALUE
+
+bool parse_value(const std::string &x, std::string &result) {
+  // An empty value is a valid string, but reading it from a stream fails.
+  if (x.empty()) {
+    result.clear();
+    return true;
+  }
+  return read_value(x, result);
+}
+
+error for_each_line(const std::string &path,
+                    const std::function<bool(const std::string &)> &f) {
+  const bool from_stdin = path == "-";
+  std::FILE *file = from_stdin ? stdin : std::fopen(path.c_str(), "rb");
+  if (file == nullptr)
+    return {error_code::cannot_open_file, path};
+  std::unique_ptr<std::FILE, int (*)(std::FILE *)> guard(
+      from_stdin ? nullptr : file, &std::fclose);
+
+  std::string line;
+  auto flush = [&] {
+    if (not line.empty() and line.back() == '\r')
+      line.pop_back();
+    return f(line);
+  };
+
+  std::array<char, 65536> buffer;
+  while (auto n = std::fread(buffer.data(), 1, buffer.size(), file)) {
+    const char *first = buffer.data();
+    const char *last = first + n;
+    while (first != last) {
+      auto eol = static_cast<const char *>(
+          std::memchr(first, '\n', last - first));
+      if (eol == nullptr) {
+        line.append(first, last);
+        break;
+      }
+      line.append(first, eol);
+      if (not flush())
+        return {};
+      line.clear();
+      first = eol + 1;
+    }
+  }
+  if (std::ferror(file))
+    return {error_code::cannot_read_file, from_stdin ? "<stdin>" : path};
+  if (not line.empty())
+    flush();
+  return {};
+}
+
+} // namespace wahl
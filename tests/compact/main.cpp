@@ -0,0 +1,88 @@
+// SPDX-License-Identifier: BSL-1.0
+
+// Built with WAHL_COMPACT to make sure that commands and groups parse through
+// the shared engine like they do through the per-command templates.
+
+#include <wahl/wahl.hpp>
+
+namespace {
+
+struct build_cmd {
+  int jobs = 1;
+  bool verbose = false;
+  std::vector<std::string> targets = {};
+
+  static bool abbreviations() { return true; }
+
+  template <class F> void parse(F f) {
+    f(jobs, "--jobs", "-j");
+    f(verbose, "--verbose", "-v", wahl::set(true));
+    f(targets);
+  }
+
+  void run() {}
+};
+
+struct tool : wahl::group<tool> {
+  std::string config = "";
+  int ran = 0;
+
+  template <class F> void parse(F f) {
+    f(config, "--config", "-c", wahl::required());
+  }
+};
+
+struct deploy : tool::command<deploy> {
+  std::string target = "";
+
+  deploy() {}
+
+  static const char *help() { return "Deploy the build"; }
+
+  template <class F> void parse(F f) { f(target, "--target", "-t"); }
+
+  void run(tool &parent) {
+    if (target == "prod" and parent.config == "ci.toml")
+      ++parent.ran;
+  }
+};
+
+} // namespace
+
+int main() {
+  static_assert(WAHL_COMPACT, "this test requires compact mode");
+
+  build_cmd cmd;
+  if (not wahl::parse(std::nothrow, cmd, {"--verb", "-j", "4", "all", "docs"}))
+    return 1;
+  if (cmd.jobs != 4 or not cmd.verbose or cmd.targets.size() != 2)
+    return 1;
+
+  auto r = wahl::parse(std::nothrow, cmd, {"all", "--nope"});
+  if (r or r.error().code() != wahl::error_code::unknown_flag or
+      r.error().index() != 1 or
+      r.error().message() != "build_cmd: unknown flag: --nope")
+    return 1;
+
+  tool t;
+  r = wahl::parse(std::nothrow, t, {"-c", "ci.toml", "deploy", "-t", "prod"});
+  if (not r or t.ran != 1)
+    return 1;
+
+  r = wahl::parse(std::nothrow, t, {"-c", "x", "deploy", "--nope"});
+  if (r or r.error().code() != wahl::error_code::unknown_flag or
+      r.error().index() != 3)
+    return 1;
+
+  r = wahl::parse(std::nothrow, t, {"deplyo"});
+  if (r or r.error().code() != wahl::error_code::unknown_command)
+    return 1;
+
+  // Paths that build a context per command share the group registry.
+  std::vector<int> counts;
+  tool u;
+  if (not wahl::parse_only(std::nothrow, u, {"-c", "y", "deploy"}, &counts) or
+      counts != std::vector<int>{1})
+    return 1;
+  return 0;
+}
@@ -0,0 +1,27 @@
+// SPDX-License-Identifier: BSL-1.0
+
+// A multi-call binary whose links are created by wahl_add_multicall_links.
+// Invoked as `greet NAME`, it succeeds only if it was dispatched by name.
+
+#include <wahl/wahl.hpp>
+
+namespace {
+
+struct multicall : wahl::group<multicall> {};
+
+struct greet : multicall::command<greet> {
+  std::string name = "";
+
+  greet() {}
+
+  template <class F> void parse(F f) { f(name, wahl::required()); }
+
+  void run(multicall &) { std::exit(name == "world" ? 0 : 1); }
+};
+
+} // namespace
+
+int main(int argc, char const *argv[]) {
+  wahl::parse_multicall<multicall>(argc, argv);
+  return EXIT_FAILURE;
+}
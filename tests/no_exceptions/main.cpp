@@ -0,0 +1,53 @@
+// SPDX-License-Identifier: BSL-1.0
+
+// Built with exceptions disabled to make sure that the header does not depend
+// on them. Errors are reported through the std::nothrow overloads.
+
+#include <wahl/wahl.hpp>
+
+struct build_cmd {
+  int jobs = 1;
+  std::vector<std::string> targets = {};
+
+  template <class F> void parse(F f) {
+    f(jobs, "--jobs", "-j");
+    f(targets);
+  }
+
+  void run() {}
+};
+
+struct check_cmd {
+  std::vector<int> values = {};
+  wahl::execution exec;
+
+  template <class F> void parse(F f) {
+    f(values, wahl::each(
+                  [](int x) {
+                    if (x > 9)
+                      wahl::fail(wahl::error::custom("not a digit"));
+                  },
+                  exec));
+    f(exec.jobs, "--jobs", "-j");
+  }
+
+  void run() {}
+};
+
+int main() {
+  build_cmd cmd;
+  if (not wahl::parse(std::nothrow, cmd, {"-j", "4", "all"}) or cmd.jobs != 4)
+    return 1;
+
+  auto r = wahl::parse(std::nothrow, cmd, {"--nope"});
+  if (r or r.error().code() != wahl::error_code::unknown_flag)
+    return 1;
+
+  check_cmd check;
+  if (not wahl::parse(std::nothrow, check, {"-j", "2", "1", "2", "3"}))
+    return 1;
+  r = wahl::parse(std::nothrow, check, {"-j", "2", "1", "20", "3"});
+  if (r or r.error().code() != wahl::error_code::custom)
+    return 1;
+  return 0;
+}
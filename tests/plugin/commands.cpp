@@ -0,0 +1,35 @@
+// SPDX-License-Identifier: BSL-1.0
+
+// A plugin library with two commands of the test program. It does not link
+// against wahl, and uses the library that the test program exports instead.
+
+#include "tool.hpp"
+
+namespace {
+
+struct deploy {
+  std::string target = "";
+
+  template <class F> void parse(F f) {
+    f(target, "--target", "-t", wahl::required());
+  }
+
+  void run(tool &parent) {
+    parent.ran.push_back("deploy " + target + " with " + parent.config);
+  }
+};
+
+struct release {
+  int version = 0;
+
+  template <class F> void parse(F f) { f(version, "--version", "-V"); }
+
+  void run(tool &parent) {
+    parent.ran.push_back("release " + std::to_string(version));
+  }
+};
+
+} // namespace
+
+WAHL_PLUGIN(deploy, tool)
+WAHL_PLUGIN(release, tool)
@@ -0,0 +1,109 @@
+// SPDX-License-Identifier: BSL-1.0
+
+// Loads subcommands from the plugin library at WAHL_TEST_PLUGIN, and makes
+// sure that the library is only opened once a plugin command is dispatched.
+
+#include "tool.hpp"
+
+#include <cstdio>
+#include <fstream>
+#include <iostream>
+
+#include <dlfcn.h>
+
+namespace {
+
+int failures = 0;
+
+void check(bool condition, const char *what) {
+  if (not condition) {
+    std::cerr << "FAILED: " << what << '\n';
+    ++failures;
+  }
+}
+
+bool plugin_loaded() {
+  auto handle = ::dlopen(WAHL_TEST_PLUGIN, RTLD_NOW | RTLD_NOLOAD);
+  if (handle != nullptr)
+    ::dlclose(handle);
+  return handle != nullptr;
+}
+
+struct local : tool::command<local> {
+  local() {}
+
+  void run(tool &parent) { parent.ran.push_back("local"); }
+};
+
+} // namespace
+
+int main() {
+  std::string library = WAHL_TEST_PLUGIN;
+  auto slash = library.find_last_of('/');
+  auto manifest = library.substr(0, slash + 1) + "plugins.manifest";
+  {
+    std::ofstream out(manifest);
+    out << "# Commands of the test plugin\n\n"
+        << "release " << library.substr(slash + 1) << " Publish a release\n";
+  }
+
+  tool::add_plugin("deploy", "Deploy the build", library);
+  tool::add_plugin("missing", "Not there", library + ".missing");
+  tool::add_plugin("unexported", "Not exported", library, "wahl_nope");
+  check(not tool::add_plugins(manifest), "the manifest is read");
+  check(tool::add_plugins(manifest + ".missing").code() ==
+            wahl::error_code::cannot_open_file,
+        "a missing manifest is reported");
+
+  {
+    auto cli = tool{};
+    auto r = wahl::parse(std::nothrow, cli, {"local"});
+    check(r and cli.ran == std::vector<std::string>{"local"},
+          "regular subcommands run");
+    check(not plugin_loaded(), "dispatching to regular commands loads nothing");
+  }
+
+  {
+    auto subcommands = tool::subcommands();
+    check(subcommands.count("deploy") and subcommands.count("release"),
+          "plugins are listed in the help");
+    check(subcommands.at("release").help == "Publish a release",
+          "the manifest provides the help");
+    check(not plugin_loaded(), "listing the help loads nothing");
+  }
+
+  {
+    auto cli = tool{};
+    auto r = wahl::parse(std::nothrow, cli,
+                         {"-c", "ci.toml", "deploy", "--target", "prod"});
+    check(bool(r), "the plugin command parses");
+    check(plugin_loaded(), "dispatching loads the plugin");
+    check(cli.ran == std::vector<std::string>{"deploy prod with ci.toml"},
+          "the plugin command runs with its parent");
+
+    r = wahl::parse(std::nothrow, cli, {"release", "-V", "3"});
+    check(r and cli.ran.back() == "release 3",
+          "the manifest's relative path resolves");
+  }
+
+  {
+    auto cli = tool{};
+    auto r = wahl::parse(std::nothrow, cli, {"-c", "x", "deploy", "--nope"});
+    check(not r and r.error().code() == wahl::error_code::unknown_flag and
+              r.error().index() == 3,
+          "plugin errors are relative to the parent arguments");
+
+    r = wahl::parse(std::nothrow, cli, {"missing"});
+    check(not r and r.error().code() == wahl::error_code::cannot_load_plugin,
+          "missing libraries are reported");
+
+    r = wahl::parse(std::nothrow, cli, {"unexported"});
+    check(not r and
+              r.error().message() == "cannot load plugin: " + library +
+                                         ": missing symbol wahl_nope",
+          "missing entry points are reported");
+  }
+
+  std::remove(manifest.c_str());
+  return failures == 0 ? EXIT_SUCCESS : EXIT_FAILURE;
+}
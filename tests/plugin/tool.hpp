@@ -0,0 +1,14 @@
+// SPDX-License-Identifier: BSL-1.0
+
+// The group that the test program and its plugin library share.
+
+#pragma once
+
+#include <wahl/wahl.hpp>
+
+struct tool : wahl::group<tool> {
+  std::string config = "";
+  std::vector<std::string> ran = {};
+
+  template <class F> void parse(F f) { f(config, "--config", "-c"); }
+};
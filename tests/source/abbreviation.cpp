@@ -0,0 +1,126 @@
+// SPDX-License-Identifier: BSL-1.0
+
+#include <wahl/wahl.hpp>
+#include <doctest/doctest.h>
+
+struct abbreviation_cmd {
+  static bool abbreviations() { return true; }
+
+  size_t verbose = 0;
+  std::string version = "";
+  std::string name = "";
+
+  template <class F> void parse(F f) {
+    f(verbose, "--verbose", "--verbosity", "-v", wahl::count());
+    f(version, "--version");
+    f(name, "--name", "-N");
+  }
+
+  void run() {}
+};
+
+TEST_CASE("abbreviated long options") {
+  auto cmd = abbreviation_cmd{};
+
+  SUBCASE("unique prefixes resolve to their flag") {
+    wahl::parse(cmd, {"--verb", "--na", "hello", "--vers=1.0"});
+    CHECK_EQ(cmd.verbose, 1);
+    CHECK_EQ(cmd.name, "hello");
+    CHECK_EQ(cmd.version, "1.0");
+  }
+
+  SUBCASE("aliases of the same flag are not ambiguous") {
+    wahl::parse(cmd, {"--verbo", "--verbos"});
+    CHECK_EQ(cmd.verbose, 2);
+  }
+
+  SUBCASE("ambiguous prefixes list their candidates") {
+    CHECK_THROWS_WITH(wahl::parse(cmd, {"--ver"}),
+                      "abbreviation_cmd: ambiguous flag: --ver could be "
+                      "--verbose, --version");
+  }
+
+  SUBCASE("short flags are never abbreviated") {
+    CHECK_THROWS(wahl::parse(cmd, {"-n", "hello"}));
+  }
+}
+
+struct exact_cmd {
+  std::string name = "";
+
+  template <class F> void parse(F f) { f(name, "--name"); }
+
+  void run() {}
+};
+
+TEST_CASE("abbreviations are opt-in") {
+  auto cmd = exact_cmd{};
+  CHECK_THROWS_WITH(wahl::parse(cmd, {"--na", "hello"}),
+                    "exact_cmd: unknown flag: --na");
+}
+
+struct abbreviation_cli : wahl::group<abbreviation_cli> {
+  static bool abbreviations() { return true; }
+  std::string name = "";
+};
+
+struct initialize : abbreviation_cli::command<initialize> {
+  initialize() {}
+  void run(abbreviation_cli &c) { c.name = "initialize"; }
+};
+
+struct inspect : abbreviation_cli::command<inspect> {
+  inspect() {}
+  void run(abbreviation_cli &c) { c.name = "inspect"; }
+};
+
+struct remove_ : abbreviation_cli::command<remove_> {
+  remove_() {}
+  void run(abbreviation_cli &c) { c.name = "remove"; }
+};
+
+TEST_CASE("abbreviated subcommands") {
+  auto cmd = abbreviation_cli{};
+
+  SUBCASE("unique prefixes dispatch to their command") {
+    wahl::parse(cmd, {"ini"});
+    CHECK_EQ(cmd.name, "initialize");
+  }
+
+  SUBCASE("exact names take precedence") {
+    wahl::parse(cmd, {"remove"});
+    CHECK_EQ(cmd.name, "remove");
+  }
+
+  SUBCASE("ambiguous prefixes list their candidates") {
+    CHECK_THROWS_WITH(wahl::parse(cmd, {"in"}),
+                      "abbreviation_cli: ambiguous command: in could be "
+                      "initialize, inspect");
+  }
+}
+
+struct late_cli : wahl::group<late_cli> {
+  static bool abbreviations() { return true; }
+  std::string name = "";
+};
+
+struct package : late_cli::command<package> {
+  package() {}
+  void run(late_cli &c) { c.name = "package"; }
+};
+
+TEST_CASE("subcommands added after the first parse are abbreviated") {
+  auto cmd = late_cli{};
+  wahl::parse(cmd, {"pack"});
+  CHECK_EQ(cmd.name, "package");
+
+  late_cli::add_plugin("publish", "Publish a package",
+                       "wahl-no-such-plugin.so");
+  auto r = wahl::parse(std::nothrow, cmd, {"pub"});
+  REQUIRE_FALSE(r);
+  CHECK_EQ(r.error().code(), wahl::error_code::cannot_load_plugin);
+
+  r = wahl::parse(std::nothrow, cmd, {"p"});
+  REQUIRE_FALSE(r);
+  CHECK_EQ(r.error().code(), wahl::error_code::ambiguous_command);
+}
@@ -0,0 +1,184 @@
+// SPDX-License-Identifier: BSL-1.0
+
+#include <wahl/wahl.hpp>
+#include <doctest/doctest.h>
+
+#include <cstdlib>
+#include <new>
+
+// Route every allocation of the test binary through the accounting hook. The
+// whole family of replaceable operators is replaced, so that every operator
+// delete releases memory from the matching operator new.
+namespace {
+
+void *allocate(std::size_t size) noexcept {
+  wahl::record_allocation(size);
+  return std::malloc(size ? size : 1);
+}
+
+void *allocate_or_throw(std::size_t size) {
+  if (auto *ptr = allocate(size))
+    return ptr;
+  throw std::bad_alloc{};
+}
+
+void deallocate(void *ptr) noexcept { std::free(ptr); }
+
+} // namespace
+
+void *operator new(std::size_t size) { return allocate_or_throw(size); }
+
+void *operator new[](std::size_t size) { return allocate_or_throw(size); }
+
+void *operator new(std::size_t size, const std::nothrow_t &) noexcept {
+  return allocate(size);
+}
+
+void *operator new[](std::size_t size, const std::nothrow_t &) noexcept {
+  return allocate(size);
+}
+
+void operator delete(void *ptr) noexcept { deallocate(ptr); }
+
+void operator delete[](void *ptr) noexcept { deallocate(ptr); }
+
+void operator delete(void *ptr, std::size_t) noexcept { deallocate(ptr); }
+
+void operator delete[](void *ptr, std::size_t) noexcept { deallocate(ptr); }
+
+void operator delete(void *ptr, const std::nothrow_t &) noexcept {
+  deallocate(ptr);
+}
+
+void operator delete[](void *ptr, const std::nothrow_t &) noexcept {
+  deallocate(ptr);
+}
+
+namespace {
+
+template <class F> wahl::allocation_counters count_allocations(F f) {
+  wahl::reset_allocation_stats();
+  f();
+  return wahl::allocation_stats();
+}
+
+struct flags_cmd {
+  int count = 0;
+  std::string name = "";
+  bool verbose = false;
+  bool force = false;
+
+  template <class F> void parse(F f) {
+    f(count, "--count", "-C");
+    f(name, "--name", "-N");
+    f(verbose, "--verbose", "-v", wahl::set(true));
+    f(force, "--force", "-f", wahl::set(true));
+  }
+
+  void run() {}
+};
+
+struct container_cmd {
+  std::vector<int> ids = {};
+  std::vector<std::string> files = {};
+
+  template <class F> void parse(F f) {
+    f(ids, "--id", "-I");
+    f(files);
+  }
+
+  void run() {}
+};
+
+struct alloc_cli : wahl::group<alloc_cli> {};
+
+struct alloc_sub : alloc_cli::command<alloc_sub> {
+  alloc_sub() {}
+  int level = 0;
+
+  template <class F> void parse(F f) { f(level, "--level", "-l"); }
+
+  void run() {}
+};
+
+struct static_flags_cmd {
+  int count = 0;
+  long limit = 0;
+  bool verbose = false;
+  bool force = false;
+
+  static constexpr auto schema() {
+    return wahl::schema(
+        wahl::option<&static_flags_cmd::count>("--count", "-C"),
+        wahl::option<&static_flags_cmd::limit>("--limit", "-L"),
+        wahl::option<&static_flags_cmd::verbose>("--verbose", "-v"),
+        wahl::option<&static_flags_cmd::force>("--force", "-f"));
+  }
+
+  void run() {}
+};
+
+} // namespace
+
+TEST_CASE("allocations are attributed to parse phases") {
+  auto stats = count_allocations([] {
+    flags_cmd cmd;
+    wahl::parse(cmd, {"--count", "5", "-vf", "--name=hello"});
+  });
+  CHECK_GT(stats.allocations_in(wahl::parse_phase::context_build), 0);
+  CHECK_GT(stats.bytes_in(wahl::parse_phase::context_build), 0);
+  CHECK_EQ(stats.parse_allocations(),
+           stats.allocations_in(wahl::parse_phase::context_build) +
+               stats.allocations_in(wahl::parse_phase::tokenization) +
+               stats.allocations_in(wahl::parse_phase::value_write) +
+               stats.allocations_in(wahl::parse_phase::callback));
+  CHECK_EQ(wahl::current_parse_phase(), wahl::parse_phase::none);
+}
+
+// The bounds leave some headroom for differences between standard library
+// implementations, but are tight enough to catch regressions.
+TEST_CASE("allocation upper bounds") {
+  SUBCASE("flags") {
+    auto stats = count_allocations([] {
+      flags_cmd cmd;
+      wahl::parse(cmd, {"--count", "5", "--name=hello"});
+    });
+    CHECK_LE(stats.parse_allocations(), 40);
+  }
+
+  SUBCASE("bundled short flags") {
+    auto stats = count_allocations([] {
+      flags_cmd cmd;
+      wahl::parse(cmd, {"-vf", "-C5"});
+    });
+    CHECK_LE(stats.parse_allocations(), 40);
+  }
+
+  SUBCASE("containers") {
+    auto stats = count_allocations([] {
+      container_cmd cmd;
+      wahl::parse(cmd, {"--id", "1", "2", "3", "a", "b", "c"});
+    });
+    CHECK_LE(stats.parse_allocations(), 32);
+  }
+
+  SUBCASE("nested groups") {
+    auto stats = count_allocations([] {
+      alloc_cli cmd;
+      wahl::parse(cmd, {"alloc_sub", "--level", "3"});
+    });
+    CHECK_LE(stats.parse_allocations(), 56);
+  }
+}
+
+TEST_CASE("static schemas parse without allocating") {
+  const char *argv[] = {"--count", "5", "-vf", "--limit=100000", "-C7"};
+  static_flags_cmd cmd;
+  auto stats = count_allocations(
+      [&] { wahl::parse_static(cmd, std::begin(argv), std::end(argv)); });
+  CHECK_EQ(stats.parse_allocations(), 0);
+  CHECK_EQ(cmd.count, 7);
+  CHECK_EQ(cmd.limit, 100000);
+  CHECK(cmd.verbose);
+  CHECK(cmd.force);
+}
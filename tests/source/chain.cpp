@@ -0,0 +1,157 @@
+// SPDX-License-Identifier: BSL-1.0
+
+#include <wahl/wahl.hpp>
+#include <doctest/doctest.h>
+
+namespace {
+
+// The group carries the state of the pipeline from one command to the next.
+struct pipeline : wahl::group<pipeline> {
+  std::vector<std::string> log = {};
+  int value = 0;
+  bool verbose = false;
+
+  template <class F> void parse(F f) {
+    f(verbose, "--verbose", "-v", wahl::set(true));
+  }
+};
+
+struct fetch : pipeline::command<fetch> {
+  fetch() {}
+
+  int x = 0;
+
+  template <class F> void parse(F f) { f(x, "--x"); }
+
+  void run(pipeline &p) {
+    p.value = x;
+    p.log.push_back("fetch");
+  }
+};
+
+struct transform : pipeline::command<transform> {
+  transform() {}
+
+  int y = 1;
+  std::string op = "*";
+
+  template <class F> void parse(F f) {
+    f(y, "--y", wahl::required());
+    f(op, "--op");
+  }
+
+  void run(pipeline &p) {
+    p.value = op == "+" ? p.value + y : p.value * y;
+    p.log.push_back("transform " + op);
+  }
+};
+
+struct upload : pipeline::command<upload> {
+  upload() {}
+
+  void run(pipeline &p) {
+    p.log.push_back("upload " + std::to_string(p.value));
+  }
+};
+
+struct tag : pipeline::command<tag> {
+  tag() {}
+
+  std::vector<std::string> names = {};
+
+  template <class F> void parse(F f) { f(names); }
+
+  void run(pipeline &p) { p.log.push_back("tag " + wahl::join(names, " ")); }
+};
+
+using args = std::vector<std::string>;
+
+} // namespace
+
+TEST_CASE("chained subcommands") {
+  auto cmd = pipeline{};
+
+  SUBCASE("commands run in order with shared state") {
+    auto r = wahl::parse_chain(
+        std::nothrow, cmd,
+        {"fetch", "--x", "3", "+", "transform", "--y", "4", "+", "upload"});
+    REQUIRE(r);
+    CHECK_EQ(cmd.log, args{"fetch", "transform *", "upload 12"});
+  }
+
+  SUBCASE("commands may repeat") {
+    auto r = wahl::parse_chain(std::nothrow, cmd,
+                               {"upload", "+", "fetch", "--x", "2", "+",
+                                "upload"});
+    REQUIRE(r);
+    CHECK_EQ(cmd.log, args{"upload 0", "fetch", "upload 2"});
+  }
+
+  SUBCASE("errors are reported before anything runs") {
+    auto r = wahl::parse_chain(
+        std::nothrow, cmd,
+        {"fetch", "--x", "3", "+", "transform", "--z", "4", "+", "upload"});
+    REQUIRE_FALSE(r);
+    CHECK_EQ(r.error().code(), wahl::error_code::unknown_flag);
+    CHECK_EQ(r.error().index(), 5);
+    CHECK(cmd.log.empty());
+
+    r = wahl::parse_chain(std::nothrow, cmd,
+                          {"fetch", "+", "transform", "+", "upload"});
+    REQUIRE_FALSE(r);
+    CHECK_EQ(r.error().code(), wahl::error_code::missing_required);
+    CHECK(cmd.log.empty());
+
+    r = wahl::parse_chain(std::nothrow, cmd, {"fetch", "+", "publish"});
+    REQUIRE_FALSE(r);
+    CHECK_EQ(r.error().code(), wahl::error_code::unknown_command);
+    CHECK_EQ(r.error().index(), 2);
+
+    r = wahl::parse_chain(std::nothrow, cmd, {"fetch", "+"});
+    REQUIRE_FALSE(r);
+    CHECK_EQ(r.error().code(), wahl::error_code::unknown_command);
+    CHECK(cmd.log.empty());
+  }
+
+  SUBCASE("flags of the group come first") {
+    auto r = wahl::parse_chain(std::nothrow, cmd,
+                               {"--verbose", "fetch", "--x", "3", "+",
+                                "upload"});
+    REQUIRE(r);
+    CHECK(cmd.verbose);
+    CHECK_EQ(cmd.log, args{"fetch", "upload 3"});
+
+    r = wahl::parse_chain(std::nothrow, cmd, {"--nope", "fetch", "+", "upload"});
+    REQUIRE_FALSE(r);
+    CHECK_EQ(r.error().code(), wahl::error_code::unknown_flag);
+    CHECK_EQ(r.error().index(), 0);
+  }
+
+  SUBCASE("separators only split where a command can start") {
+    auto r = wahl::parse_chain(std::nothrow, cmd,
+                               {"fetch", "--x", "2", "+", "transform", "--y",
+                                "5", "--op", "+", "+", "upload"});
+    REQUIRE(r);
+    CHECK_EQ(cmd.log, args{"fetch", "transform +", "upload 7"});
+
+    cmd.log.clear();
+    r = wahl::parse_chain(std::nothrow, cmd,
+                          {"upload", "+", "tag", "a", "--", "+", "upload"});
+    REQUIRE(r);
+    CHECK_EQ(cmd.log, args{"upload 7", "tag a + upload"});
+  }
+
+  SUBCASE("custom separator") {
+    auto r = wahl::parse_chain(std::nothrow, cmd,
+                               {"fetch", "--x", "5", "then", "upload"}, "then");
+    REQUIRE(r);
+    CHECK_EQ(cmd.log, args{"fetch", "upload 5"});
+  }
+
+  SUBCASE("arguments without a separator are parsed as usual") {
+    auto r = wahl::parse_chain(std::nothrow, cmd, {"fetch", "--x", "7"});
+    REQUIRE(r);
+    CHECK_EQ(cmd.log, args{"fetch"});
+    CHECK_EQ(cmd.value, 7);
+  }
+}
@@ -0,0 +1,137 @@
+// SPDX-License-Identifier: BSL-1.0
+
+#include <wahl/wahl.hpp>
+#include <doctest/doctest.h>
+
+namespace {
+
+struct export_cmd {
+  bool json = false;
+  bool yaml = false;
+  bool quiet = false;
+  bool verbose = false;
+  std::string key = "";
+  std::string cert = "";
+  std::string output = "";
+
+  template <class F> void parse(F f) {
+    f(json, "--json", wahl::set(true));
+    f(yaml, "--yaml", wahl::set(true));
+    f(quiet, "--quiet", "-q", wahl::set(true));
+    f(verbose, "--verbose", "-v", wahl::set(true));
+    f(key, "--tls-key");
+    f(cert, "--tls-cert");
+    f(output, "--output", "-o");
+    f(wahl::exactly_one_of("--json", "--yaml"));
+    f(wahl::at_most_one_of("--quiet", "--verbose"));
+    f(wahl::implies("--tls-key", "--tls-cert", "--output"));
+    f(wahl::conflicts("--quiet", "--tls-key"));
+  }
+
+  void run() {}
+};
+
+struct wide_cmd {
+  std::vector<int> values = std::vector<int>(150);
+
+  template <class F> void parse(F f) {
+    for (int i = 0; i < 150; ++i)
+      f(values[i], "--f" + std::to_string(i));
+    f(wahl::exactly_one_of("--f1", "--f70", "--f140"));
+    f(wahl::implies("--f149", "--f0", "--f64", "--f128"));
+  }
+
+  void run() {}
+};
+
+struct typo_cmd {
+  bool a = false;
+
+  template <class F> void parse(F f) {
+    f(a, "-a", wahl::set(true));
+    f(wahl::at_most_one_of("-a", "-b"));
+  }
+
+  void run() {}
+};
+
+std::string message(const wahl::result &r) {
+  REQUIRE_FALSE(r);
+  CHECK_EQ(r.error().code(), wahl::error_code::constraint_violation);
+  return r.error().message();
+}
+
+} // namespace
+
+TEST_CASE("constraint groups") {
+  auto cmd = export_cmd{};
+
+  SUBCASE("satisfied constraints") {
+    CHECK(wahl::parse(std::nothrow, cmd, {"--json", "-v"}));
+    CHECK(wahl::parse(std::nothrow, cmd,
+                      {"--yaml", "--tls-key", "k", "--tls-cert", "c", "-o",
+                       "out"}));
+  }
+
+  SUBCASE("exactly one of") {
+    CHECK_EQ(message(wahl::parse(std::nothrow, cmd, {"-q"})),
+             "export_cmd: one of --json, --yaml is required");
+    CHECK_EQ(message(wahl::parse(std::nothrow, cmd, {"--json", "--yaml"})),
+             "export_cmd: --json and --yaml cannot be used together");
+  }
+
+  SUBCASE("at most one of") {
+    CHECK_EQ(message(wahl::parse(std::nothrow, cmd, {"--json", "-q", "-v"})),
+             "export_cmd: --quiet and --verbose cannot be used together");
+  }
+
+  SUBCASE("implies lists the missing flags") {
+    CHECK_EQ(message(wahl::parse(std::nothrow, cmd,
+                                 {"--json", "--tls-key", "k"})),
+             "export_cmd: --tls-key requires --tls-cert and --output");
+    CHECK_EQ(message(wahl::parse(std::nothrow, cmd,
+                                 {"--json", "--tls-key", "k", "-o", "x"})),
+             "export_cmd: --tls-key requires --tls-cert");
+  }
+
+  SUBCASE("violations are combined") {
+    CHECK_EQ(message(wahl::parse(std::nothrow, cmd,
+                                 {"-q", "-v", "--tls-key", "k", "--tls-cert",
+                                  "c", "-o", "x"})),
+             "export_cmd: one of --json, --yaml is required; --quiet and "
+             "--verbose cannot be used together; --quiet cannot be used "
+             "with --tls-key");
+  }
+
+  SUBCASE("the throwing overload raises the combined message") {
+    CHECK_THROWS_WITH(wahl::parse(cmd, {"--json", "--yaml"}),
+                      "export_cmd: --json and --yaml cannot be used together");
+  }
+}
+
+TEST_CASE("constraints across bitset words") {
+  auto cmd = wide_cmd{};
+  CHECK(wahl::parse(std::nothrow, cmd, {"--f70", "1"}));
+  CHECK_EQ(message(wahl::parse(std::nothrow, cmd,
+                               {"--f1", "1", "--f140", "2"})),
+           "wide_cmd: --f1 and --f140 cannot be used together");
+  CHECK_EQ(message(wahl::parse(std::nothrow, cmd,
+                               {"--f70", "1", "--f149", "1", "--f64", "1"})),
+           "wide_cmd: --f149 requires --f0 and --f128");
+}
+
+TEST_CASE("constraints on undeclared flags") {
+  auto cmd = typo_cmd{};
+  auto r = wahl::parse(std::nothrow, cmd, {"-a"});
+  REQUIRE_FALSE(r);
+  CHECK_EQ(r.error().code(), wahl::error_code::unknown_flag);
+  CHECK_EQ(r.error().token(), "-b");
+
+  // The flags are resolved when the context is built, before any argument is
+  // scanned.
+  auto ctx = wahl::build_context(cmd);
+  CHECK_EQ(ctx.declaration_error.token(), "-b");
+  r = wahl::parse(std::nothrow, cmd, {"--nope"});
+  REQUIRE_FALSE(r);
+  CHECK_EQ(r.error().token(), "-b");
+}
@@ -0,0 +1,97 @@
+// SPDX-License-Identifier: BSL-1.0
+
+#include <wahl/wahl.hpp>
+#include <doctest/doctest.h>
+
+#include <iostream>
+#include <sstream>
+
+namespace {
+
+int probes = 0;
+
+struct build_cmd {
+  int jobs = 0;
+  std::string host = "";
+
+  template <class F> void parse(F f) {
+    f(jobs, "--jobs", "-j", wahl::help("Number of parallel jobs"),
+      wahl::default_from(
+          [] {
+            ++probes;
+            return 8;
+          },
+          "number of CPUs"));
+    f(host, "--host", wahl::default_from([] { return std::string("local"); }));
+  }
+
+  void run() {}
+};
+
+int cpus() { return 8; }
+
+int memory() { return 64; }
+
+// Both providers have the type int (*)(), and both lambdas have the same
+// closure type.
+struct limits_cmd {
+  int cpus = 0;
+  int memory = 0;
+  int threads = 0;
+  int depth = 0;
+
+  template <class F> void parse(F f) {
+    auto constant = [](int n) {
+      return wahl::default_from([n] { return n; });
+    };
+    f(cpus, "--cpus", wahl::default_from(&::cpus));
+    f(memory, "--memory", wahl::default_from(&::memory));
+    f(threads, "--threads", constant(4));
+    f(depth, "--depth", constant(16));
+  }
+
+  void run() {}
+};
+
+} // namespace
+
+TEST_CASE("lazily computed defaults") {
+  auto cmd = build_cmd{};
+  REQUIRE(wahl::parse(std::nothrow, cmd, {"-j", "2", "--host", "remote"}));
+  CHECK_EQ(cmd.jobs, 2);
+  CHECK_EQ(cmd.host, "remote");
+  CHECK_EQ(probes, 0);
+
+  for (int i = 0; i < 3; ++i) {
+    cmd = build_cmd{};
+    REQUIRE(wahl::parse(std::nothrow, cmd, {}));
+    CHECK_EQ(cmd.jobs, 8);
+    CHECK_EQ(cmd.host, "local");
+  }
+  CHECK_EQ(probes, 1);
+
+  std::ostringstream out;
+  auto old = std::cout.rdbuf(out.rdbuf());
+  cmd = build_cmd{};
+  auto r = wahl::parse(std::nothrow, cmd, {"-h"});
+  std::cout.rdbuf(old);
+  CHECK(r);
+  CHECK_NE(out.str().find("Number of parallel jobs (default: number of CPUs)"),
+           std::string::npos);
+  CHECK_NE(out.str().find("(default: computed)"), std::string::npos);
+  CHECK_EQ(probes, 1);
+}
+
+TEST_CASE("defaults of the same type are cached separately") {
+  auto cmd = limits_cmd{};
+  REQUIRE(wahl::parse(std::nothrow, cmd, {"--memory", "32"}));
+  CHECK_EQ(cmd.cpus, 8);
+  CHECK_EQ(cmd.memory, 32);
+  CHECK_EQ(cmd.threads, 4);
+  CHECK_EQ(cmd.depth, 16);
+
+  cmd = limits_cmd{};
+  REQUIRE(wahl::parse(std::nothrow, cmd, {}));
+  CHECK_EQ(cmd.cpus, 8);
+  CHECK_EQ(cmd.memory, 64);
+}
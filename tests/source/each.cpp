@@ -0,0 +1,124 @@
+// SPDX-License-Identifier: BSL-1.0
+
+#include <wahl/wahl.hpp>
+#include <doctest/doctest.h>
+
+#include <atomic>
+#include <iostream>
+#include <mutex>
+#include <set>
+#include <sstream>
+
+namespace {
+
+struct square_cmd {
+  std::vector<int> inputs = {};
+  wahl::execution exec;
+  std::mutex mutex;
+  std::multiset<int> results = {};
+  std::atomic<int> calls{0};
+
+  template <class F> void parse(F f) {
+    f(inputs, wahl::each(
+                  [this](int x) {
+                    ++calls;
+                    if (x < 0) {
+                      wahl::fail(wahl::error::custom(
+                          "negative input: " + std::to_string(x)));
+                      return;
+                    }
+                    std::lock_guard<std::mutex> lock(mutex);
+                    results.insert(x * x);
+                  },
+                  exec));
+    f(exec.jobs, "--jobs", "-j");
+    f(exec.ordered, "--unordered", wahl::set(false));
+  }
+
+  void run() {}
+};
+
+struct echo_cmd {
+  std::vector<std::string> words = {};
+  int ran = 0;
+
+  template <class F> void parse(F f) {
+    f(words, wahl::each([](const std::string &x) { return x + "!"; }));
+  }
+
+  void run() { ++ran; }
+};
+
+} // namespace
+
+TEST_CASE("per-item execution") {
+  auto cmd = square_cmd{};
+
+  SUBCASE("every item runs once") {
+    std::deque<std::string> args = {"-j", "4"};
+    for (int i = 0; i < 1000; ++i)
+      args.push_back(std::to_string(i));
+    REQUIRE(wahl::parse(std::nothrow, cmd, args));
+    CHECK_EQ(cmd.calls, 1000);
+    REQUIRE_EQ(cmd.results.size(), 1000);
+    CHECK_EQ(*cmd.results.rbegin(), 999 * 999);
+    CHECK_EQ(cmd.results.count(25), 1);
+  }
+
+  SUBCASE("sequential execution with -j 1") {
+    REQUIRE(wahl::parse(std::nothrow, cmd, {"-j", "1", "1", "2", "3"}));
+    CHECK_EQ(cmd.results, std::multiset<int>{1, 4, 9});
+  }
+
+  SUBCASE("the first error cancels the remaining items") {
+    std::deque<std::string> args = {"-j", "1", "--", "1", "-5", "2", "-7"};
+    auto r = wahl::parse(std::nothrow, cmd, args);
+    REQUIRE_FALSE(r);
+    CHECK_EQ(r.error().code(), wahl::error_code::custom);
+    CHECK_EQ(r.error().message(), "negative input: -5");
+    CHECK_EQ(cmd.calls, 2);
+    CHECK_EQ(cmd.results, std::multiset<int>{1});
+  }
+
+  SUBCASE("errors with many threads report the first failed item") {
+    std::deque<std::string> args = {"-j", "8", "--unordered", "--"};
+    for (int i = 0; i < 100; ++i)
+      args.push_back(std::to_string(i == 10 or i == 90 ? -i : i));
+    auto r = wahl::parse(std::nothrow, cmd, args);
+    REQUIRE_FALSE(r);
+    CHECK_NE(r.error().message().find("negative input"), std::string::npos);
+    CHECK_LE(cmd.calls, 100);
+  }
+
+  SUBCASE("no items") {
+    CHECK(wahl::parse(std::nothrow, cmd, {"-j", "4"}));
+    CHECK_EQ(cmd.calls, 0);
+  }
+}
+
+TEST_CASE("per-item output") {
+  wahl::execution exec;
+  exec.jobs = 3;
+  std::vector<int> items(200);
+  for (int i = 0; i < 200; ++i)
+    items[i] = i;
+  std::ostringstream out;
+  auto old = std::cout.rdbuf(out.rdbuf());
+  auto to_string = [](int x) { return std::to_string(x); };
+  auto e = wahl::run_each(items, to_string, exec);
+  std::cout.rdbuf(old);
+  REQUIRE_FALSE(e);
+  std::string expected;
+  for (int i = 0; i < 200; ++i)
+    expected += std::to_string(i) + "\n";
+  CHECK_EQ(out.str(), expected);
+
+  auto cmd = echo_cmd{};
+  out.str({});
+  old = std::cout.rdbuf(out.rdbuf());
+  auto r = wahl::parse(std::nothrow, cmd, {"a", "b"});
+  std::cout.rdbuf(old);
+  CHECK(r);
+  CHECK_EQ(cmd.ran, 1);
+  CHECK_EQ(out.str(), "a!\nb!\n");
+}
@@ -0,0 +1,157 @@
+// SPDX-License-Identifier: BSL-1.0
+
+#include <wahl/wahl.hpp>
+#include <doctest/doctest.h>
+
+#include <filesystem>
+#include <fstream>
+
+namespace {
+
+std::deque<std::string> split(std::string_view line,
+                              const wahl::expansion &options = {}) {
+  std::deque<std::string> result;
+  auto e = wahl::split_arguments(line, result, options);
+  CHECK_MESSAGE(not e, e.message());
+  return result;
+}
+
+using args = std::deque<std::string>;
+
+struct cat_cmd {
+  std::vector<std::string> files = {};
+  bool number = false;
+
+  template <class F> void parse(F f) {
+    f(files);
+    f(number, "-n", wahl::set(true));
+  }
+
+  void run() {}
+};
+
+} // namespace
+
+TEST_CASE("splitting command lines") {
+  CHECK_EQ(split("  a  b\tc "), args{"a", "b", "c"});
+  CHECK_EQ(split("'a b' \"c d\" e\\ f"), args{"a b", "c d", "e f"});
+  CHECK_EQ(split("x'y'\"z\" '' \"\""), args{"xyz", "", ""});
+  CHECK_EQ(split("\"say \\\"hi\\\" \\n\""), args{"say \"hi\" \\n"});
+  CHECK(split("").empty());
+
+  std::deque<std::string> result;
+  auto e = wahl::split_arguments("a 'b", result);
+  CHECK_EQ(e.code(), wahl::error_code::invalid_value);
+}
+
+TEST_CASE("brace expansion") {
+  CHECK_EQ(split("shard-{a,b,c}.log"),
+           args{"shard-a.log", "shard-b.log", "shard-c.log"});
+  CHECK_EQ(split("{a,b}{1,2}"), args{"a1", "a2", "b1", "b2"});
+  CHECK_EQ(split("x{a,b{c,d}}y"), args{"xay", "xbcy", "xbdy"});
+  CHECK_EQ(split("{1..3}"), args{"1", "2", "3"});
+  CHECK_EQ(split("{3..1}"), args{"3", "2", "1"});
+  CHECK_EQ(split("{08..11}"), args{"08", "09", "10", "11"});
+  CHECK_EQ(split("{0..10..5} {-1..1}"), args{"0", "5", "10", "-1", "0", "1"});
+  CHECK_EQ(split("{a..c}"), args{"a", "b", "c"});
+  CHECK_EQ(split("{a} {} {x {a,b"), args{"{a}", "{}", "{x", "{a,b"});
+  CHECK_EQ(split("{ {a,b}"), args{"{", "a", "b"});
+  CHECK_EQ(split("'{a,b}' \\{a,b} \"{1..2}\""),
+           args{"{a,b}", "{a,b}", "{1..2}"});
+  CHECK_EQ(split("{a,b}", {false, true}), args{"{a,b}"});
+  CHECK_EQ(split("shard-{0..63}").size(), 64);
+
+  // Expansions stream, so that the limits stop them early.
+  wahl::limits l;
+  l.max_tokens = 100;
+  wahl::limit_scope scope(l);
+  std::size_t seen = 0;
+  auto e = wahl::split_arguments("{1..1000000000}", [&](const std::string &) {
+    ++seen;
+    return true;
+  });
+  CHECK_EQ(e.code(), wahl::error_code::limit_exceeded);
+  CHECK_EQ(seen, 100);
+}
+
+TEST_CASE("expansions are capped") {
+  auto cmd = cat_cmd{};
+  auto r = wahl::parse_line(std::nothrow, cmd, "{1..1000000000}",
+                            wahl::expansion{});
+  REQUIRE_FALSE(r);
+  CHECK_EQ(r.error().code(), wahl::error_code::limit_exceeded);
+  CHECK_EQ(r.error().message(), "limit exceeded: more than 65536 arguments");
+  CHECK(cmd.files.empty());
+
+  wahl::expansion options;
+  options.max_arguments = 3;
+  std::deque<std::string> result;
+  CHECK_EQ(wahl::split_arguments("{1..3}", result, options).code(),
+           wahl::error_code::none);
+  CHECK_EQ(wahl::split_arguments("a {1..3}", result, options).code(),
+           wahl::error_code::limit_exceeded);
+
+  options.max_arguments = 0;
+  std::size_t seen = 0;
+  auto e = wahl::split_arguments(
+      "{1..100000}",
+      [&](const std::string &) {
+        ++seen;
+        return true;
+      },
+      options);
+  CHECK_FALSE(e);
+  CHECK_EQ(seen, 100000);
+
+  // Collected arguments count against the memory budget while they stream.
+  wahl::limits l;
+  l.memory_budget = 100 * (sizeof(std::string) + 3);
+  {
+    wahl::limit_scope scope(l);
+    cmd = cat_cmd{};
+    r = wahl::parse_line(std::nothrow, cmd, "{100..999}", wahl::expansion{});
+    REQUIRE_FALSE(r);
+    CHECK_EQ(r.error().message(),
+             "limit exceeded: more than " + std::to_string(l.memory_budget) +
+                 " bytes of memory");
+  }
+  wahl::limit_scope scope(l);
+  result.clear();
+  CHECK_EQ(wahl::split_arguments("{100..999}", result).code(),
+           wahl::error_code::limit_exceeded);
+  CHECK_EQ(result.size(), 100);
+}
+
+TEST_CASE("glob expansion") {
+  namespace fs = std::filesystem;
+  auto dir = fs::temp_directory_path() / "wahl_expand_test";
+  fs::remove_all(dir);
+  fs::create_directories(dir / "logs" / "old");
+  for (auto name : {"a.gz", "b.gz", "c.txt", ".hidden.gz", "old/d.gz"})
+    std::ofstream(dir / "logs" / name) << name;
+  auto root = dir.string();
+
+  CHECK_EQ(split(root + "/logs/*.gz"),
+           args{root + "/logs/a.gz", root + "/logs/b.gz"});
+  CHECK_EQ(split(root + "/logs/[!a]*"),
+           args{root + "/logs/b.gz", root + "/logs/c.txt", root + "/logs/old"});
+  CHECK_EQ(split(root + "/logs/?.{gz,txt}"),
+           args{root + "/logs/a.gz", root + "/logs/b.gz",
+                root + "/logs/c.txt"});
+  CHECK_EQ(split(root + "/*/*/d.gz"), args{root + "/logs/old/d.gz"});
+  CHECK_EQ(split(root + "/logs/*/"), args{root + "/logs/old/"});
+  CHECK_EQ(split(root + "/logs/.*.gz"), args{root + "/logs/.hidden.gz"});
+  // Quoted patterns and patterns without matches stay as they are.
+  CHECK_EQ(split("'" + root + "/logs/*.gz'"), args{root + "/logs/*.gz"});
+  CHECK_EQ(split(root + "/logs/*.zip"), args{root + "/logs/*.zip"});
+  CHECK_EQ(split(root + "/logs/*.gz", {true, false}),
+           args{root + "/logs/*.gz"});
+
+  auto cmd = cat_cmd{};
+  auto r = wahl::parse_line(std::nothrow, cmd, "-n " + root + "/logs/*.gz",
+                            wahl::expansion{});
+  CHECK(r);
+  CHECK(cmd.number);
+  CHECK_EQ(cmd.files.size(), 2);
+  fs::remove_all(dir);
+}
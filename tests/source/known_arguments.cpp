@@ -0,0 +1,105 @@
+// SPDX-License-Identifier: BSL-1.0
+
+#include <wahl/wahl.hpp>
+#include <doctest/doctest.h>
+
+namespace {
+
+struct wrapper_cmd {
+  int jobs = 1;
+  bool dry_run = false;
+
+  template <class F> void parse(F f) {
+    f(jobs, "--jobs", "-j");
+    f(dry_run, "--dry-run", "-n", wahl::set(true));
+  }
+
+  void run() {}
+};
+
+struct positional_cmd {
+  std::vector<std::string> files = {};
+  bool force = false;
+
+  template <class F> void parse(F f) {
+    f(force, "--force", wahl::set(true));
+    f(files);
+  }
+
+  void run() {}
+};
+
+std::vector<std::string> to_vector(const wahl::argv_view &view) {
+  return {view.begin(), view.end()};
+}
+
+} // namespace
+
+TEST_CASE("parsing known arguments") {
+  auto cmd = wrapper_cmd{};
+
+  SUBCASE("unknown arguments are collected in order") {
+    const char *argv[] = {"wrap", "--color", "-j", "4", "always", "-n",
+                          "--x=1", nullptr};
+    auto known = wahl::parse_known(cmd, 7, argv);
+    CHECK_EQ(cmd.jobs, 4);
+    CHECK(cmd.dry_run);
+    CHECK_FALSE(known.terminated);
+    CHECK_EQ(to_vector(known.unknown),
+             std::vector<std::string>{"--color", "always", "--x=1"});
+    CHECK(known.rest.empty());
+    CHECK_EQ(to_vector(known.forward), to_vector(known.unknown));
+    CHECK_EQ(*known.forward.end(), nullptr);
+  }
+
+  SUBCASE("the remainder after the terminator is not parsed") {
+    const char *argv[] = {"wrap", "-j2",  "--", "make",
+                          "-j",   "all", nullptr};
+    auto known = wahl::parse_known(cmd, 6, argv);
+    CHECK_EQ(cmd.jobs, 2);
+    CHECK(known.terminated);
+    CHECK(known.unknown.empty());
+    CHECK_EQ(to_vector(known.rest),
+             std::vector<std::string>{"make", "-j", "all"});
+    CHECK_EQ(known.rest.data()[known.rest.size()], nullptr);
+  }
+
+  SUBCASE("views point into the original argument vector") {
+    const char *argv[] = {"wrap", "--verbose", "-j", "3", "--", "ls",
+                          nullptr};
+    auto known = wahl::parse_known(cmd, 6, argv);
+    CHECK_EQ(known.unknown.data(), argv + 3);
+    CHECK_EQ(known.rest.data(), argv + 5);
+    CHECK_EQ(to_vector(known.forward),
+             std::vector<std::string>{"--verbose", "--", "ls"});
+    auto exec_argv = known.exec_argv("child");
+    CHECK_EQ(exec_argv, argv + 2);
+    CHECK_EQ(std::string(exec_argv[0]), "child");
+    CHECK_EQ(std::string(exec_argv[1]), "--verbose");
+    CHECK_EQ(exec_argv[4], nullptr);
+  }
+
+  SUBCASE("an empty argument vector has no slot for the program name") {
+    const char *argv[] = {nullptr};
+    auto known = wahl::parse_known(cmd, 0, argv);
+    CHECK(known.forward.empty());
+    CHECK_EQ(known.exec_argv("child"), nullptr);
+    CHECK_EQ(argv[0], nullptr);
+  }
+}
+
+TEST_CASE("argument terminator") {
+  auto cmd = positional_cmd{};
+
+  SUBCASE("arguments after the terminator are positional") {
+    wahl::parse(cmd, {"a", "--", "--force", "-b"});
+    CHECK_FALSE(cmd.force);
+    CHECK_EQ(cmd.files, std::vector<std::string>{"a", "--force", "-b"});
+  }
+
+  SUBCASE("the terminator requires a positional capture") {
+    auto wrapper = wrapper_cmd{};
+    CHECK_THROWS_WITH(wahl::parse(wrapper, {"--", "x"}),
+                      "unknown command: x");
+  }
+}
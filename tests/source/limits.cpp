@@ -0,0 +1,182 @@
+// SPDX-License-Identifier: BSL-1.0
+
+// The memory checks rely on the allocation hook that allocation.cpp installs
+// for the whole test binary.
+
+#include <wahl/wahl.hpp>
+#include <doctest/doctest.h>
+
+#include <cstdio>
+#include <fstream>
+#include <random>
+
+namespace {
+
+struct upload_cmd {
+  std::vector<std::string> files = {};
+  std::vector<std::string> tags = {};
+  std::vector<int> ids = {};
+  std::string name = "";
+  bool verbose = false;
+
+  template <class F> void parse(F f) {
+    f(files);
+    f(tags, "--tag", "-t");
+    f(ids, "--ids", wahl::values_from_file());
+    f(name, "--name", "-n");
+    f(verbose, "--verbose", "-v", wahl::set(true));
+  }
+
+  void run() {}
+};
+
+struct service : wahl::group<service> {};
+
+struct upload : service::command<upload> {
+  upload_cmd options;
+
+  upload() {}
+
+  template <class F> void parse(F f) { options.parse(f); }
+
+  void run(service &) {}
+};
+
+wahl::limits strict() {
+  wahl::limits l;
+  l.max_tokens = 64;
+  l.max_token_length = 32;
+  l.max_values = 8;
+  l.max_depth = 2;
+  l.max_bytes = 512;
+  l.memory_budget = 4096;
+  return l;
+}
+
+wahl::error_code bounded_error(const std::deque<std::string> &a,
+                               const wahl::limits &l = strict()) {
+  auto cmd = upload_cmd{};
+  auto r = wahl::parse_bounded(std::nothrow, cmd, a, l);
+  return r ? wahl::error_code::none : r.error().code();
+}
+
+std::deque<std::string> repeat(std::string x, std::size_t n) {
+  return std::deque<std::string>(n, std::move(x));
+}
+
+} // namespace
+
+TEST_CASE("parsing within limits") {
+  auto cmd = upload_cmd{};
+  auto args = std::deque<std::string>{"a", "b", "-t", "x", "--name=n", "-v"};
+  REQUIRE(wahl::parse_bounded(std::nothrow, cmd, args, strict()));
+  CHECK_EQ(cmd.files, std::vector<std::string>{"a", "b"});
+
+  SUBCASE("token count") {
+    auto r = wahl::parse_bounded(std::nothrow, cmd, repeat("a", 65), strict());
+    REQUIRE_FALSE(r);
+    CHECK_EQ(r.error().code(), wahl::error_code::limit_exceeded);
+    CHECK_EQ(r.error().message(), "limit exceeded: more than 64 tokens");
+  }
+
+  SUBCASE("token length") {
+    auto r = wahl::parse_bounded(std::nothrow, cmd,
+                                 {"a", "--name=" + std::string(100, 'x')},
+                                 strict());
+    REQUIRE_FALSE(r);
+    CHECK_EQ(r.error().index(), 1);
+    CHECK_EQ(r.error().message(),
+             "limit exceeded: more than 32 bytes in a token (--name=" +
+                 std::string(25, 'x') + "...)");
+  }
+
+  SUBCASE("values per argument") {
+    CHECK_EQ(bounded_error(repeat("a", 8)), wahl::error_code::none);
+    auto r = wahl::parse_bounded(std::nothrow, cmd, repeat("a", 9), strict());
+    REQUIRE_FALSE(r);
+    CHECK_EQ(r.error().index(), 8);
+    auto tags = std::deque<std::string>{"-t"};
+    for (int i = 0; i < 9; ++i)
+      tags.push_back("x");
+    CHECK_EQ(bounded_error(tags), wahl::error_code::limit_exceeded);
+    CHECK_EQ(bounded_error({"-vvvvvvvv"}), wahl::error_code::none);
+    CHECK_EQ(bounded_error({"-vvvvvvvvv"}), wahl::error_code::limit_exceeded);
+    CHECK_EQ(bounded_error(repeat("-v", 9)), wahl::error_code::limit_exceeded);
+  }
+
+  SUBCASE("values from files") {
+    auto path = std::string("wahl_limits_ids.txt");
+    {
+      std::ofstream out(path);
+      for (int i = 0; i < 20; ++i)
+        out << i << '\n';
+    }
+    CHECK_EQ(bounded_error({"--ids", path}), wahl::error_code::limit_exceeded);
+    auto relaxed = strict();
+    relaxed.max_values = 0;
+    CHECK_EQ(bounded_error({"--ids", path}, relaxed), wahl::error_code::none);
+    std::remove(path.c_str());
+  }
+
+  SUBCASE("total bytes and memory") {
+    CHECK_EQ(bounded_error(repeat(std::string(30, 'a'), 20)),
+             wahl::error_code::limit_exceeded);
+    auto relaxed = strict();
+    relaxed.max_bytes = 0;
+    relaxed.max_values = 0;
+    CHECK_EQ(bounded_error(repeat(std::string(30, 'a'), 20), relaxed),
+             wahl::error_code::none);
+    relaxed.memory_budget = 1024;
+    CHECK_EQ(bounded_error(repeat(std::string(30, 'a'), 20), relaxed),
+             wahl::error_code::limit_exceeded);
+  }
+
+  SUBCASE("nesting depth") {
+    auto cli = service{};
+    auto l = strict();
+    CHECK(wahl::parse_bounded(std::nothrow, cli, {"upload", "a"}, l));
+    l.max_depth = 1;
+    auto r = wahl::parse_bounded(std::nothrow, cli, {"upload", "a"}, l);
+    REQUIRE_FALSE(r);
+    CHECK_EQ(r.error().code(), wahl::error_code::limit_exceeded);
+    CHECK_EQ(r.error().index(), 0);
+  }
+
+  SUBCASE("limits end with their scope") {
+    {
+      wahl::limit_scope scope(strict());
+      CHECK_NE(wahl::active_limits(), nullptr);
+    }
+    CHECK_EQ(wahl::active_limits(), nullptr);
+    CHECK(wahl::parse(std::nothrow, cmd, repeat("a", 1000)));
+  }
+}
+
+TEST_CASE("hostile inputs stay within bounded memory") {
+  std::mt19937 rng(42);
+  auto pick = [&](std::size_t n) {
+    return std::uniform_int_distribution<std::size_t>(0, n - 1)(rng);
+  };
+  const std::string pieces[] = {"upload", "-t", "--tag", "--name", "-v",
+                                "-vvvvvvvv", "--", "-", "--ids", "x", "=",
+                                "--name="};
+  auto l = strict();
+  for (int round = 0; round < 300; ++round) {
+    // Mostly small inputs that hit individual limits, and some huge ones.
+    auto count = round % 10 == 0 ? 10000 + pick(100000) : pick(100);
+    std::deque<std::string> args;
+    for (std::size_t i = 0; i < count; ++i) {
+      auto x = pieces[pick(std::size(pieces))];
+      if (pick(8) == 0)
+        x += std::string(pick(round % 7 == 0 ? 100000 : 40), 'a' + pick(26));
+      args.push_back(std::move(x));
+    }
+    auto cli = service{};
+    wahl::reset_allocation_stats();
+    auto r = wahl::parse_bounded(std::nothrow, cli, args, l);
+    auto bytes = wahl::allocation_stats().parse_bytes();
+    CHECK_MESSAGE(bytes < 64 * 1024, "round " << round << ": " << bytes);
+    if (count > l.max_tokens)
+      CHECK_EQ(r.error().code(), wahl::error_code::limit_exceeded);
+  }
+}
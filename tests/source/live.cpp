@@ -0,0 +1,92 @@
+// SPDX-License-Identifier: BSL-1.0
+
+#include <wahl/wahl.hpp>
+#include <doctest/doctest.h>
+
+#include <atomic>
+#include <cstdio>
+#include <fstream>
+#include <thread>
+
+namespace {
+
+struct daemon_config {
+  int workers = 1;
+  std::string log = "info";
+  bool json = false;
+  bool yaml = false;
+
+  template <class F> void parse(F f) {
+    f(workers, "--workers", "-w");
+    f(log, "--log");
+    f(json, "--json", wahl::set(true));
+    f(yaml, "--yaml", wahl::set(true));
+    f(wahl::at_most_one_of("--json", "--yaml"));
+  }
+
+  void run() {}
+};
+
+} // namespace
+
+TEST_CASE("live configuration") {
+  auto config = wahl::live<daemon_config>{};
+  CHECK_EQ(config.get()->workers, 1);
+
+  SUBCASE("reloads publish a fresh snapshot") {
+    REQUIRE(config.reload({"--workers", "8", "--json"}));
+    auto snapshot = config.get();
+    CHECK_EQ(snapshot->workers, 8);
+    CHECK_EQ(snapshot->log, "info");
+    CHECK(snapshot->json);
+  }
+
+  SUBCASE("failed reloads keep the current snapshot") {
+    REQUIRE(config.reload({"--workers", "4"}));
+    auto r = config.reload({"--json", "--yaml"});
+    REQUIRE_FALSE(r);
+    CHECK_EQ(r.error().code(), wahl::error_code::constraint_violation);
+    CHECK_EQ(config.get()->workers, 4);
+    CHECK_FALSE(config.reload({"--workers", "2", "--nope"}));
+    CHECK_EQ(config.get()->workers, 4);
+  }
+
+  SUBCASE("readers keep their snapshot while others are published") {
+    std::atomic<bool> done{false};
+    std::atomic<int> torn{0};
+    std::thread reader([&] {
+      while (not done) {
+        auto snapshot = config.get();
+        if (snapshot->log != "level" + std::to_string(snapshot->workers))
+          if (snapshot->workers != 1)
+            ++torn;
+      }
+    });
+    for (int i = 2; i < 200; ++i)
+      config.reload({"-w", std::to_string(i), "--log",
+                     "level" + std::to_string(i)});
+    done = true;
+    reader.join();
+    CHECK_EQ(torn, 0);
+    CHECK_EQ(config.get()->workers, 199);
+  }
+}
+
+TEST_CASE("arguments from a file") {
+  auto path = std::string("wahl_live_arguments.txt");
+  {
+    std::ofstream out(path);
+    out << "# daemon.conf\n--workers\n  16\n\n--log\ndebug\n";
+  }
+  std::deque<std::string> args = {"--json"};
+  REQUIRE_FALSE(wahl::read_arguments(path, args));
+  std::remove(path.c_str());
+  CHECK_EQ(args, std::deque<std::string>{"--json", "--workers", "16",
+                                         "--log", "debug"});
+  auto config = wahl::live<daemon_config>{};
+  REQUIRE(config.reload(args));
+  CHECK_EQ(config.get()->workers, 16);
+  CHECK_EQ(config.get()->log, "debug");
+  CHECK_EQ(wahl::read_arguments("does-not-exist", args).code(),
+           wahl::error_code::cannot_open_file);
+}
@@ -0,0 +1,65 @@
+// SPDX-License-Identifier: BSL-1.0
+
+#include <wahl/wahl.hpp>
+#include <doctest/doctest.h>
+
+namespace {
+
+struct toolbox : wahl::group<toolbox> {
+  std::string root = "/";
+  std::vector<std::string> ran = {};
+
+  template <class F> void parse(F f) { f(root, "--root"); }
+};
+
+struct ls : toolbox::command<ls> {
+  bool all = false;
+
+  ls() {}
+
+  template <class F> void parse(F f) { f(all, "-a", wahl::set(true)); }
+
+  void run(toolbox &parent) {
+    parent.ran.push_back(std::string("ls") + (all ? " -a" : "") + " in " +
+                         parent.root);
+  }
+};
+
+} // namespace
+
+TEST_CASE("program names") {
+  CHECK_EQ(wahl::program_name("/usr/local/bin/ls"), "ls");
+  CHECK_EQ(wahl::program_name("./toolbox"), "toolbox");
+  CHECK_EQ(wahl::program_name("ls"), "ls");
+  CHECK_EQ(wahl::program_name(""), "");
+}
+
+TEST_CASE("multi-call binaries") {
+  auto cli = toolbox{};
+
+  SUBCASE("the program name selects the subcommand") {
+    char const *argv[] = {"/usr/bin/ls", "-a", nullptr};
+    REQUIRE(wahl::parse_multicall(std::nothrow, cli, 2, argv));
+    CHECK_EQ(cli.ran, std::vector<std::string>{"ls -a in /"});
+  }
+
+  SUBCASE("other names parse the arguments as usual") {
+    char const *argv[] = {"bin/toolbox", "--root", "/tmp", "ls", nullptr};
+    REQUIRE(wahl::parse_multicall(std::nothrow, cli, 4, argv));
+    CHECK_EQ(cli.ran, std::vector<std::string>{"ls in /tmp"});
+  }
+
+  SUBCASE("errors are relative to the arguments after the program name") {
+    char const *argv[] = {"ls", "-a", "--nope", nullptr};
+    auto r = wahl::parse_multicall(std::nothrow, cli, 3, argv);
+    REQUIRE_FALSE(r);
+    CHECK_EQ(r.error().code(), wahl::error_code::unknown_flag);
+    CHECK_EQ(r.error().index(), 1);
+  }
+
+  SUBCASE("an empty argument vector") {
+    char const *argv[] = {nullptr};
+    CHECK(wahl::parse_multicall(std::nothrow, cli, 0, argv));
+    CHECK(cli.ran.empty());
+  }
+}
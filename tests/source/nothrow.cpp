@@ -0,0 +1,106 @@
+// SPDX-License-Identifier: BSL-1.0
+
+#include <wahl/wahl.hpp>
+#include <doctest/doctest.h>
+
+namespace {
+
+struct checked_cmd {
+  int count = 0;
+  std::string name = "";
+  bool verbose = false;
+
+  template <class F> void parse(F f) {
+    auto check = [](auto &&data, const auto &, const wahl::argument &) {
+      if (data < 0)
+        wahl::fail(wahl::error::custom("count must not be negative"));
+    };
+    f(count, "--count", "-C", wahl::callback(check));
+    f(name, "--name", "-N", wahl::required());
+    f(verbose, "--verbose", "-v", wahl::set(true));
+  }
+
+  void run() {}
+};
+
+struct checked_cli : wahl::group<checked_cli> {};
+
+struct build : checked_cli::command<build> {
+  int jobs = 1;
+
+  build() {}
+
+  template <class F> void parse(F f) { f(jobs, "--jobs", "-j"); }
+
+  void run(checked_cli &) {}
+};
+
+} // namespace
+
+TEST_CASE("parsing without exceptions") {
+  auto cmd = checked_cmd{};
+
+  SUBCASE("successful parse") {
+    auto r = wahl::parse(std::nothrow, cmd, {"--count", "2", "-N", "x"});
+    CHECK(r);
+    CHECK_EQ(cmd.count, 2);
+    CHECK_EQ(cmd.name, "x");
+  }
+
+  SUBCASE("unknown flags report the token and its index") {
+    auto r = wahl::parse(std::nothrow, cmd, {"-N", "x", "--nope"});
+    REQUIRE_FALSE(r);
+    CHECK_EQ(r.error().code(), wahl::error_code::unknown_flag);
+    CHECK_EQ(r.error().index(), 2);
+    CHECK_EQ(r.error().token(), "--nope");
+    CHECK_EQ(r.error().message(), "checked_cmd: unknown flag: --nope");
+  }
+
+  SUBCASE("too many values") {
+    auto r = wahl::parse(std::nothrow, cmd, {"-N", "x", "y"});
+    REQUIRE_FALSE(r);
+    CHECK_EQ(r.error().code(), wahl::error_code::too_many_values);
+    CHECK_EQ(r.error().index(), 2);
+    CHECK_EQ(r.error().message(), "flag: -N expects only one argument.");
+  }
+
+  SUBCASE("missing required arguments have no index") {
+    auto r = wahl::parse(std::nothrow, cmd, {"-C", "1"});
+    REQUIRE_FALSE(r);
+    CHECK_EQ(r.error().code(), wahl::error_code::missing_required);
+    CHECK_EQ(r.error().index(), -1);
+    CHECK_EQ(r.error().message(), "required arg missing: --name, -N [string]");
+  }
+
+  SUBCASE("callbacks report errors with wahl::fail") {
+    auto r = wahl::parse(std::nothrow, cmd, {"--count=-1", "-N", "x"});
+    REQUIRE_FALSE(r);
+    CHECK_EQ(r.error().code(), wahl::error_code::custom);
+    CHECK_EQ(r.error().message(), "count must not be negative");
+  }
+
+  SUBCASE("the throwing overload raises the same error") {
+    CHECK_THROWS_WITH(wahl::parse(cmd, {"--nope"}),
+                      "checked_cmd: unknown flag: --nope");
+    try {
+      wahl::parse(cmd, {"-N", "x", "-Q"});
+    } catch (const wahl::parse_error &ex) {
+      CHECK_EQ(ex.error().code(), wahl::error_code::unknown_flag);
+      CHECK_EQ(ex.error().index(), 2);
+    }
+  }
+}
+
+TEST_CASE("subcommand errors are relative to the parent arguments") {
+  auto cli = checked_cli{};
+  auto r = wahl::parse(std::nothrow, cli, {"build", "-j", "2", "--nope"});
+  REQUIRE_FALSE(r);
+  CHECK_EQ(r.error().code(), wahl::error_code::unknown_flag);
+  CHECK_EQ(r.error().index(), 3);
+  CHECK_EQ(r.error().token(), "--nope");
+
+  r = wahl::parse(std::nothrow, cli, {"deploy"});
+  REQUIRE_FALSE(r);
+  CHECK_EQ(r.error().code(), wahl::error_code::unknown_command);
+  CHECK_EQ(r.error().index(), 0);
+}
@@ -0,0 +1,121 @@
+// SPDX-License-Identifier: BSL-1.0
+
+#include <wahl/wahl.hpp>
+#include <doctest/doctest.h>
+
+#include <set>
+
+namespace {
+
+struct ingest_cmd {
+  std::vector<int> ids = {};
+  std::set<int> unique = {};
+  std::vector<double> weights = {};
+  bool verbose = false;
+
+  template <class F> void parse(F f) {
+    f(unique, "--unique", "-u", wahl::parallel(2));
+    f(weights, "--weight", "-w", wahl::parallel(1));
+    f(verbose, "--verbose", "-v", wahl::set(true));
+    f(ids, wahl::parallel(3));
+  }
+
+  void run() {}
+};
+
+template <bool Parallel> struct values_cmd {
+  std::vector<int> ids = {};
+  std::vector<std::string> names = {};
+
+  template <class F> void parse(F f) {
+    if constexpr (Parallel) {
+      f(ids, "--id", wahl::parallel(1));
+      f(names, "--name", wahl::parallel(1));
+    } else {
+      f(ids, "--id");
+      f(names, "--name");
+    }
+  }
+
+  void run() {}
+};
+
+// Parses valid arguments serially and in parallel, and checks that both
+// store the same values.
+void agree(const std::deque<std::string> &args) {
+  auto serial = values_cmd<false>{};
+  auto parallel = values_cmd<true>{};
+  REQUIRE(wahl::parse(std::nothrow, serial, args));
+  REQUIRE(wahl::parse(std::nothrow, parallel, args));
+  CHECK_EQ(serial.ids, parallel.ids);
+  CHECK_EQ(serial.names, parallel.names);
+}
+
+} // namespace
+
+TEST_CASE("parallel conversion of container values") {
+  auto cmd = ingest_cmd{};
+
+  SUBCASE("values keep their order across chunks") {
+    std::deque<std::string> args;
+    std::vector<int> expected;
+    for (int i = 0; i < 1000; ++i) {
+      args.push_back(std::to_string(i * 7));
+      expected.push_back(i * 7);
+    }
+    wahl::parse(cmd, args);
+    CHECK_EQ(cmd.ids, expected);
+  }
+
+  SUBCASE("attached values and interleaved flags") {
+    wahl::parse(cmd, {"1", "--weight=0.5", "2", "-w", "1.5", "2.5", "-v",
+                      "3", "-u3", "-u", "2", "3"});
+    CHECK_EQ(cmd.ids, std::vector<int>{1, 2, 3});
+    CHECK_EQ(cmd.weights, std::vector<double>{0.5, 1.5, 2.5});
+    CHECK_EQ(cmd.unique, std::set<int>{2, 3});
+    CHECK(cmd.verbose);
+  }
+
+  SUBCASE("values after a terminator") {
+    wahl::parse(cmd, {"4", "--", "-5", "6"});
+    CHECK_EQ(cmd.ids, std::vector<int>{4, -5, 6});
+  }
+
+  SUBCASE("the first invalid value is reported") {
+    auto r = wahl::parse(std::nothrow, cmd,
+                         {"1", "2", "3", "4", "x", "6", "7", "y", "9"});
+    REQUIRE_FALSE(r);
+    CHECK_EQ(r.error().code(), wahl::error_code::invalid_value);
+    CHECK_EQ(r.error().index(), 4);
+    CHECK_EQ(r.error().token(), "x");
+    CHECK(cmd.ids.empty());
+  }
+
+  SUBCASE("invalid attached values point to their token") {
+    auto r = wahl::parse(std::nothrow, cmd, {"-w", "1", "--weight=abc"});
+    REQUIRE_FALSE(r);
+    CHECK_EQ(r.error().index(), 2);
+    CHECK_EQ(r.error().message(), "invalid value: abc");
+  }
+
+  SUBCASE("parsing known arguments from argv") {
+    const char *argv[] = {"ingest", "--other", "1", "-w2", "2", nullptr};
+    wahl::parse_known(cmd, 5, argv);
+    CHECK_EQ(cmd.ids, std::vector<int>{1, 2});
+    CHECK_EQ(cmd.weights, std::vector<double>{2});
+  }
+}
+
+TEST_CASE("thread pool runs every task once") {
+  wahl::thread_pool pool(4);
+  std::vector<int> hits(100);
+  for (int round = 0; round < 3; ++round)
+    pool.run(hits.size(), [&](std::size_t i) { ++hits[i]; });
+  CHECK(std::all_of(hits.begin(), hits.end(), [](int x) { return x == 3; }));
+}
+
+TEST_CASE("serial and parallel conversions agree") {
+  agree({"--id", "1", "2", "--name", "a", ""});
+  agree({"--name", "", "--id", "3"});
+  agree({"--id=", "--name", "a"});
+}
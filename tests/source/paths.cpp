@@ -0,0 +1,87 @@
+// SPDX-License-Identifier: BSL-1.0
+
+#include <wahl/wahl.hpp>
+#include <doctest/doctest.h>
+
+#include <filesystem>
+#include <fstream>
+
+namespace {
+
+struct copy_cmd {
+  std::vector<std::string> inputs = {};
+  std::string output = "";
+  std::string config = "";
+
+  template <class F> void parse(F f) {
+    f(inputs, "--input", "-i", wahl::existing_file());
+    f(output, "--output", "-o", wahl::writable_dir());
+    f(config, "--config", wahl::readable());
+  }
+
+  void run() {}
+};
+
+struct scan_cmd {
+  std::vector<std::filesystem::path> roots = {};
+
+  template <class F> void parse(F f) { f(roots, wahl::existing_dir()); }
+
+  void run() {}
+};
+
+} // namespace
+
+TEST_CASE("path validators") {
+  namespace fs = std::filesystem;
+  auto dir = fs::temp_directory_path() / "wahl_paths_test";
+  fs::create_directories(dir);
+  std::vector<std::string> files;
+  for (int i = 0; i < 100; ++i) {
+    files.push_back((dir / ("file" + std::to_string(i))).string());
+    std::ofstream{files.back()} << i;
+  }
+  auto cmd = copy_cmd{};
+
+  SUBCASE("all values pass") {
+    auto args = std::deque<std::string>{"-o", dir.string(), "--config",
+                                        files[0], "-i"};
+    args.insert(args.end(), files.begin(), files.end());
+    CHECK(wahl::parse(std::nothrow, cmd, args));
+    CHECK_EQ(cmd.inputs.size(), 100);
+  }
+
+  SUBCASE("every failure is reported in order") {
+    auto missing = (dir / "missing").string();
+    auto args = std::deque<std::string>{"-i", files[0], missing, dir.string(),
+                                        files[1]};
+    auto r = wahl::parse(std::nothrow, cmd, args);
+    REQUIRE_FALSE(r);
+    CHECK_EQ(r.error().code(), wahl::error_code::invalid_path);
+    CHECK_EQ(r.error().token(), missing);
+    CHECK_EQ(r.error().message(),
+             "invalid path: --input, -i [string...]: " + missing +
+                 " does not exist; " + dir.string() + " is a directory");
+  }
+
+  SUBCASE("single values and directories") {
+    auto r = wahl::parse(std::nothrow, cmd, {"-o", files[0]});
+    REQUIRE_FALSE(r);
+    CHECK_EQ(r.error().message(),
+             "invalid path: --output, -o [string]: " + files[0] +
+                 " is not a directory");
+    CHECK(wahl::parse(std::nothrow, cmd, {"--config", dir.string()}));
+  }
+
+  SUBCASE("path types and positional arguments") {
+    auto scan = scan_cmd{};
+    CHECK(wahl::parse(std::nothrow, scan, {dir.string()}));
+    CHECK_FALSE(wahl::parse(std::nothrow, scan, {dir.string(), files[2]}));
+  }
+
+  SUBCASE("arguments that are not given are not checked") {
+    CHECK(wahl::parse(std::nothrow, cmd, {}));
+  }
+
+  fs::remove_all(dir);
+}
@@ -0,0 +1,20 @@
+// SPDX-License-Identifier: BSL-1.0
+
+#include <wahl/wahl.hpp>
+#include <doctest/doctest.h>
+
+TEST_CASE("plugins that cannot be loaded") {
+  wahl::plugin p("deploy-prod", "wahl-no-such-plugin.so");
+  CHECK_EQ(p.symbol(), "wahl_plugin_deploy_prod");
+  CHECK_FALSE(p.loaded());
+
+  auto r = p.run({"--target", "prod"}, nullptr);
+  REQUIRE_FALSE(r);
+  CHECK_EQ(r.error().code(), wahl::error_code::cannot_load_plugin);
+  CHECK_EQ(r.error().token(), "wahl-no-such-plugin.so");
+  CHECK_FALSE(p.loaded());
+
+  // The failure is not cached, so a library that appears later still loads.
+  r = p.run({}, nullptr);
+  CHECK_EQ(r.error().code(), wahl::error_code::cannot_load_plugin);
+}
@@ -0,0 +1,114 @@
+// SPDX-License-Identifier: BSL-1.0
+
+#include <wahl/wahl.hpp>
+#include <doctest/doctest.h>
+
+#include <iostream>
+#include <sstream>
+
+namespace {
+
+struct tools : wahl::group<tools> {};
+
+struct fetch : tools::command<fetch> {
+  static const char *help() { return "Download artifacts from a mirror"; }
+  fetch() {}
+
+  int retries = 0;
+  std::string output = "";
+
+  template <class F> void parse(F f) {
+    f(retries, "--retries", wahl::help("Retry failed downloads"));
+    f(output, "--output", "-o", wahl::help("Where to write the artifacts"));
+  }
+
+  void run(tools &) {}
+};
+
+struct upload : tools::command<upload> {
+  static const char *help() { return "Upload artifacts to the store"; }
+  upload() {}
+
+  std::string bucket = "";
+
+  template <class F> void parse(F f) {
+    f(bucket, "--bucket", wahl::help("Target bucket"));
+  }
+
+  void run(tools &) {}
+};
+
+std::string command_of(const wahl::help_match &m) {
+  return m.document->command + (m.document->flags.empty() ? "" : " ") +
+         m.document->flags;
+}
+
+} // namespace
+
+TEST_CASE("help search index") {
+  wahl::help_index index;
+  index.add({"deploy", {}, "Roll out a release"});
+  index.add({"deploy", "--canary", "Roll out to a small share first"});
+  index.add({"rollback", {}, "Revert the last release"});
+
+  auto matches = index.search("release");
+  REQUIRE_EQ(matches.size(), 2);
+  CHECK_EQ(matches[0].document->command, "deploy");
+  CHECK_EQ(matches[1].document->command, "rollback");
+
+  matches = index.search("ROLL canary");
+  REQUIRE_EQ(matches.size(), 1);
+  CHECK_EQ(matches[0].document->flags, "--canary");
+
+  // Names weigh more than help texts.
+  matches = index.search("roll");
+  REQUIRE_EQ(matches.size(), 3);
+  CHECK_EQ(matches[0].document->command, "rollback");
+
+  CHECK(index.search("release canary").empty());
+  CHECK(index.search("").empty());
+  CHECK_EQ(index.search("out", 1).size(), 1);
+}
+
+TEST_CASE("help search over a group") {
+  auto index = tools::help_search_index();
+  auto matches = index->search("upload");
+  REQUIRE_FALSE(matches.empty());
+  CHECK_EQ(command_of(matches[0]), "upload");
+
+  matches = index->search("retr");
+  REQUIRE_EQ(matches.size(), 1);
+  CHECK_EQ(command_of(matches[0]), "fetch --retries");
+
+  matches = index->search("artifacts");
+  REQUIRE_EQ(matches.size(), 3);
+  CHECK(index->search("fetch bucket").empty());
+  // The implicit help flag is not indexed.
+  CHECK(index->search("show help").empty());
+
+  tools::add_help_command();
+  std::ostringstream out;
+  auto old = std::cout.rdbuf(out.rdbuf());
+  auto cmd = tools{};
+  auto r = wahl::parse(std::nothrow, cmd, {"help", "--search", "bucket"});
+  auto all = wahl::parse(std::nothrow, cmd, {"help"});
+  std::cout.rdbuf(old);
+  CHECK(r);
+  CHECK(all);
+  CHECK_NE(out.str().find("upload --bucket Target bucket"), std::string::npos);
+  CHECK_NE(out.str().find("fetch Download artifacts from a mirror"),
+           std::string::npos);
+}
+
+TEST_CASE("help search over plugins added later") {
+  auto before = tools::help_search_index();
+  CHECK(before->search("deploy").empty());
+
+  tools::add_plugin("deploy", "Roll out artifacts", "wahl-no-such-plugin.so");
+  auto matches = tools::help_search_index()->search("deploy");
+  REQUIRE_EQ(matches.size(), 1);
+  CHECK_EQ(command_of(matches[0]), "deploy");
+  CHECK_EQ(tools::help_search_index()->search("roll artifacts").size(), 1);
+  // Indices that were handed out stay valid.
+  CHECK(before->search("deploy").empty());
+}
@@ -0,0 +1,157 @@
+// SPDX-License-Identifier: BSL-1.0
+
+#include <wahl/wahl.hpp>
+#include <doctest/doctest.h>
+
+#include <limits>
+#include <list>
+
+namespace {
+
+enum class mode { fast, safe };
+
+std::istream &operator>>(std::istream &is, mode &m) {
+  std::string x;
+  is >> x;
+  m = x == "safe" ? mode::safe : mode::fast;
+  return is;
+}
+
+struct worker_cmd {
+  int jobs = 1;
+  double ratio = 0.5;
+  mode level = mode::fast;
+  bool verbose = false;
+  std::string name = "";
+  std::vector<int> ids = {};
+  std::list<std::string> files = {};
+
+  template <class F> void parse(F f) {
+    f(jobs, "--jobs", "-j");
+    f(ratio, "--ratio");
+    f(level, "--mode");
+    f(verbose, "--verbose", "-v", wahl::set(true));
+    f(nullptr, "--version", wahl::show("1.0"));
+    f(name, "--name", "-N");
+    f(ids, "--id");
+    f(files);
+  }
+
+  void run() {}
+};
+
+struct other_cmd {
+  std::string jobs = "";
+
+  template <class F> void parse(F f) { f(jobs, "--jobs"); }
+
+  void run() {}
+};
+
+struct format_cmd {
+  bool json = false;
+  bool yaml = false;
+  int indent = 2;
+
+  template <class F> void parse(F f) {
+    f(json, "--json", wahl::set(true));
+    f(wahl::at_most_one_of("--json", "--yaml"));
+    f(yaml, "--yaml", wahl::set(true));
+    f(wahl::implies("--indent", "--json"));
+    f(indent, "--indent");
+  }
+
+  void run() {}
+};
+
+} // namespace
+
+TEST_CASE("command snapshots") {
+  auto cmd = worker_cmd{};
+  std::vector<int> counts;
+  wahl::parse_only(cmd, {"a.txt", "-j", "8", "--mode=safe", "-v", "--name",
+                         "coord", "--id", "3", "1", "2", "--", "-b.txt"},
+                   &counts);
+  CHECK_EQ(counts, std::vector<int>{1, 0, 1, 1, 0, 1, 3, 2});
+  auto blob = wahl::save_snapshot(cmd, counts);
+  CHECK_EQ(blob.size() % 8, 0);
+
+  SUBCASE("restoring into a fresh command") {
+    auto restored = worker_cmd{};
+    std::vector<int> restored_counts;
+    REQUIRE(wahl::restore_snapshot(restored, blob, &restored_counts));
+    CHECK_EQ(restored.jobs, 8);
+    CHECK_EQ(restored.ratio, 0.5);
+    CHECK(restored.level == mode::safe);
+    CHECK(restored.verbose);
+    CHECK_EQ(restored.name, "coord");
+    CHECK_EQ(restored.ids, std::vector<int>{3, 1, 2});
+    CHECK_EQ(restored.files, std::list<std::string>{"a.txt", "-b.txt"});
+    CHECK_EQ(restored_counts, counts);
+  }
+
+  SUBCASE("accessing fields without copying") {
+    wahl::snapshot_view view(blob);
+    REQUIRE(view);
+    REQUIRE_EQ(view.size(), 8);
+    REQUIRE(view.find("-j"));
+    CHECK_EQ(view.find("-j")->value<int>(), 8);
+    CHECK_EQ(view.find("--ratio")->count(), 0);
+    CHECK_EQ(view.find("--name")->string(), "coord");
+    CHECK_EQ(view.find("--name")->string().data()[5], '\0');
+    auto ids = view.find("--id")->array<int>();
+    CHECK_EQ(std::vector<int>(ids.begin(), ids.end()),
+             std::vector<int>{3, 1, 2});
+    CHECK(view.find("--missing") == nullptr);
+    const auto &files = view[7];
+    REQUIRE_EQ(files.size(), 2);
+    CHECK_EQ(files.string(1), "-b.txt");
+  }
+
+  SUBCASE("damaged snapshots are rejected") {
+    auto restored = worker_cmd{};
+    auto r = wahl::restore_snapshot(restored, blob.substr(0, blob.size() - 8));
+    REQUIRE_FALSE(r);
+    CHECK_EQ(r.error().code(), wahl::error_code::invalid_snapshot);
+    CHECK_EQ(r.error().message(), "invalid snapshot: truncated blob");
+
+    auto damaged = blob;
+    damaged[0] = 'x';
+    CHECK_FALSE(wahl::snapshot_view(damaged));
+  }
+
+  SUBCASE("padding keeps the high bits of sizes") {
+    CHECK_EQ(wahl::snapshot_padded(9), 16);
+    std::uint64_t large = (std::uint64_t{1} << 32) + 1;
+    if (large <= std::numeric_limits<std::size_t>::max())
+      CHECK_EQ(wahl::snapshot_padded(std::size_t(large)), large + 7);
+  }
+
+  SUBCASE("snapshots of other commands are rejected") {
+    auto other = other_cmd{};
+    auto r = wahl::restore_snapshot(other, blob);
+    REQUIRE_FALSE(r);
+    CHECK_EQ(r.error().message(),
+             "invalid snapshot: field 0 does not match the command");
+  }
+}
+
+TEST_CASE("snapshots skip constraints") {
+  auto cmd = format_cmd{};
+  std::vector<int> counts;
+  wahl::parse_only(cmd, {"--json", "--indent", "4"}, &counts);
+  CHECK_EQ(counts, std::vector<int>{1, 0, 1});
+  auto blob = wahl::save_snapshot(cmd, counts);
+
+  wahl::snapshot_view view(blob);
+  REQUIRE_EQ(view.size(), 3);
+  CHECK_EQ(view.find("--indent")->count(), 1);
+
+  auto restored = format_cmd{};
+  std::vector<int> restored_counts;
+  REQUIRE(wahl::restore_snapshot(restored, blob, &restored_counts));
+  CHECK(restored.json);
+  CHECK_FALSE(restored.yaml);
+  CHECK_EQ(restored.indent, 4);
+  CHECK_EQ(restored_counts, counts);
+}
@@ -0,0 +1,74 @@
+// SPDX-License-Identifier: BSL-1.0
+
+#include <wahl/wahl.hpp>
+#include <doctest/doctest.h>
+
+struct static_cmd {
+  size_t count = 0;
+  std::string name = "";
+  std::vector<std::string> tags = {};
+  bool verbose = false;
+  bool force = false;
+  std::vector<std::string> files = {};
+
+  static constexpr auto schema() {
+    return wahl::schema(wahl::option<&static_cmd::count>("--count", "-C"),
+                        wahl::option<&static_cmd::name>("--name", "-N"),
+                        wahl::option<&static_cmd::tags>("--tag", "-T"),
+                        wahl::option<&static_cmd::verbose>("--verbose", "-v"),
+                        wahl::option<&static_cmd::force>("--force", "-f"),
+                        wahl::positional<&static_cmd::files>());
+  }
+
+  void run() {}
+};
+
+static_assert(static_cmd::schema().has_unique_flags());
+static_assert(static_cmd::schema().find("-N") == 1);
+static_assert(static_cmd::schema().find("--unknown") == -1);
+static_assert(static_cmd::schema().positional_index() == 5);
+static_assert(not wahl::schema(wahl::option<&static_cmd::count>("-C"),
+                               wahl::option<&static_cmd::name>("-C"))
+                       .has_unique_flags());
+
+TEST_CASE("static schema command") {
+  auto cmd = static_cmd{};
+
+  SUBCASE("long options with space and equal-sign") {
+    wahl::parse_static(cmd, {"--count", "5", "--name=hello"});
+    CHECK_EQ(cmd.count, 5);
+    CHECK_EQ(cmd.name, "hello");
+  }
+
+  SUBCASE("short options without space") {
+    wahl::parse_static(cmd, {"-C5", "-Nhello"});
+    CHECK_EQ(cmd.count, 5);
+    CHECK_EQ(cmd.name, "hello");
+  }
+
+  SUBCASE("bundled short switches") {
+    wahl::parse_static(cmd, {"-vf"});
+    CHECK(cmd.verbose);
+    CHECK(cmd.force);
+  }
+
+  SUBCASE("multiple values and positional arguments") {
+    wahl::parse_static(cmd, {"a", "-T", "1", "2", "--count=3", "b", "c"});
+    CHECK_EQ(cmd.count, 3);
+    CHECK_EQ(cmd.tags, std::vector<std::string>{"1", "2"});
+    CHECK_EQ(cmd.files, std::vector<std::string>{"a", "b", "c"});
+  }
+
+  SUBCASE("parsing from argv") {
+    const char *argv[] = {"-C", "7", "--verbose", "x"};
+    wahl::parse_static(cmd, std::begin(argv), std::end(argv));
+    CHECK_EQ(cmd.count, 7);
+    CHECK(cmd.verbose);
+    CHECK_EQ(cmd.files, std::vector<std::string>{"x"});
+  }
+
+  SUBCASE("unknown flags are rejected") {
+    CHECK_THROWS_WITH(wahl::parse_static(cmd, {"--nope"}),
+                      "static_cmd: unknown flag: --nope");
+  }
+}
@@ -0,0 +1,108 @@
+// SPDX-License-Identifier: BSL-1.0
+
+#include <wahl/wahl.hpp>
+#include <doctest/doctest.h>
+
+namespace {
+
+struct archive_cmd {
+  static bool abbreviations() { return true; }
+
+  bool verbose = false;
+  bool quiet = false;
+  std::string output = "";
+  std::string owner = "";
+  std::vector<std::string> files = {};
+
+  template <class F> void parse(F f) {
+    f(verbose, "--verbose", "-v", wahl::set(true));
+    f(quiet, "--quiet", "-q", wahl::set(true));
+    f(output, "--output", "-o");
+    f(owner, "--owner");
+    f(files);
+  }
+
+  void run() {}
+};
+
+struct archive_cli : wahl::group<archive_cli> {};
+
+struct extract : archive_cli::command<extract> {
+  extract() {}
+
+  void run(archive_cli &) {}
+};
+
+std::vector<wahl::token> tokenize(const wahl::context_base &ctx,
+                                  const std::vector<std::string> &args) {
+  wahl::iterator_tokens<std::vector<std::string>::const_iterator> tokens(
+      args.begin(), args.end());
+  std::vector<wahl::token> result;
+  wahl::tokenize(ctx, tokens, result);
+  return result;
+}
+
+} // namespace
+
+TEST_CASE("tokenizer") {
+  auto cmd = archive_cmd{};
+  auto ctx = wahl::build_context(cmd);
+  auto output = ctx.flag_id("--output");
+
+  SUBCASE("flags, attached values, and positionals") {
+    std::vector<std::string> args = {"a.txt", "--output=x.tar", "-ox.tar",
+                                     "-o", "x.tar"};
+    auto stream = tokenize(ctx, args);
+    REQUIRE_EQ(stream.size(), 5);
+    CHECK_EQ(stream[0].kind, wahl::token_kind::value);
+    CHECK_EQ(stream[0].text, "a.txt");
+    CHECK_EQ(stream[1].kind, wahl::token_kind::flag);
+    CHECK_EQ(stream[1].argument, output);
+    CHECK_EQ(stream[1].text, "--output");
+    CHECK_EQ(stream[1].value, "x.tar");
+    CHECK_EQ(stream[1].value.data(), args[1].data() + 9);
+    CHECK_EQ(stream[2].text, "-o");
+    CHECK_EQ(stream[2].value, "x.tar");
+    CHECK_EQ(stream[3].value, "");
+    CHECK_EQ(stream[4].kind, wahl::token_kind::value);
+    CHECK_EQ(stream[4].index, 4);
+  }
+
+  SUBCASE("bundled short flags share their source index") {
+    auto stream = tokenize(ctx, {"-vqx"});
+    REQUIRE_EQ(stream.size(), 3);
+    CHECK_EQ(stream[0].kind, wahl::token_kind::flag);
+    CHECK_EQ(stream[1].kind, wahl::token_kind::bundled);
+    CHECK_EQ(stream[1].argument, ctx.flag_id("-q"));
+    CHECK_EQ(stream[2].kind, wahl::token_kind::bundled);
+    CHECK_EQ(stream[2].argument, -1);
+    CHECK_EQ(stream[2].text, "x");
+    CHECK_EQ(stream[2].index, 0);
+  }
+
+  SUBCASE("abbreviations resolve to their flag") {
+    auto stream = tokenize(ctx, {"--outp=a", "--o", "--nope"});
+    REQUIRE_EQ(stream.size(), 3);
+    CHECK_EQ(stream[0].kind, wahl::token_kind::flag);
+    CHECK_EQ(stream[0].text, "--output");
+    CHECK_EQ(stream[0].value, "a");
+    CHECK_EQ(stream[1].kind, wahl::token_kind::ambiguous);
+    CHECK_EQ(stream[2].kind, wahl::token_kind::unknown);
+  }
+
+  SUBCASE("arguments after a terminator are values") {
+    auto stream = tokenize(ctx, {"-v", "--", "-q", "--output"});
+    REQUIRE_EQ(stream.size(), 4);
+    CHECK_EQ(stream[1].kind, wahl::token_kind::terminator);
+    CHECK_EQ(stream[2].kind, wahl::token_kind::value);
+    CHECK_EQ(stream[3].kind, wahl::token_kind::value);
+  }
+}
+
+TEST_CASE("tokenizer stops at subcommands") {
+  auto cli = archive_cli{};
+  auto ctx = wahl::build_context(cli);
+  auto stream = tokenize(ctx, {"extract", "--anything", "x"});
+  REQUIRE_EQ(stream.size(), 1);
+  CHECK_EQ(stream[0].kind, wahl::token_kind::subcommand);
+}
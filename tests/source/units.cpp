@@ -0,0 +1,212 @@
+// SPDX-License-Identifier: BSL-1.0
+
+#include <wahl/wahl.hpp>
+#include <doctest/doctest.h>
+
+#include <chrono>
+#include <limits>
+
+using namespace std::chrono_literals;
+
+namespace {
+
+struct service_cmd {
+  std::chrono::milliseconds timeout = 1s;
+  std::chrono::duration<double> grace = 0s;
+  wahl::byte_size cache = {};
+  wahl::quantity batch = {};
+  wahl::rate limit = {};
+  std::vector<std::chrono::seconds> retries = {};
+
+  template <class F> void parse(F f) {
+    f(timeout, "--timeout", "-t");
+    f(grace, "--grace");
+    f(cache, "--cache");
+    f(batch, "--batch");
+    f(limit, "--rate");
+    f(retries, "--retry");
+  }
+
+  void run() {}
+};
+
+std::int64_t duration(const std::string &x) {
+  std::int64_t ns = -1;
+  REQUIRE_MESSAGE(wahl::parse_duration(x, ns), x);
+  return ns;
+}
+
+std::uint64_t bytes(const std::string &x) {
+  std::uint64_t result = 0;
+  REQUIRE_MESSAGE(wahl::parse_byte_size(x, result), x);
+  return result;
+}
+
+std::uint64_t quantity(const std::string &x) {
+  std::uint64_t result = 0;
+  REQUIRE_MESSAGE(wahl::parse_quantity(x, result), x);
+  return result;
+}
+
+} // namespace
+
+TEST_CASE("duration parsing") {
+  std::int64_t ns = 0;
+
+  SUBCASE("units") {
+    CHECK_EQ(duration("7ns"), 7);
+    CHECK_EQ(duration("7us"), 7000);
+    CHECK_EQ(duration("7\xc2\xb5s"), 7000);
+    CHECK_EQ(duration("250ms"), 250000000);
+    CHECK_EQ(duration("2s"), 2000000000);
+    CHECK_EQ(duration("3m"), 180000000000);
+    CHECK_EQ(duration("3min"), 180000000000);
+    CHECK_EQ(duration("1h"), 3600000000000);
+    CHECK_EQ(duration("1d"), 86400000000000);
+    CHECK_EQ(duration("0"), 0);
+  }
+
+  SUBCASE("fractions, compounds, and signs") {
+    CHECK_EQ(duration("1.5h"), 5400000000000);
+    CHECK_EQ(duration("0.001s"), 1000000);
+    CHECK_EQ(duration("1.250000s"), 1250000000);
+    CHECK_EQ(duration("1h30m15s"), 5415000000000);
+    CHECK_EQ(duration("-2ms"), -2000000);
+    CHECK_EQ(duration("+2ms"), 2000000);
+  }
+
+  SUBCASE("the largest value") {
+    CHECK_EQ(duration("9223372036854775807ns"),
+             std::numeric_limits<std::int64_t>::max());
+    CHECK_FALSE(wahl::parse_duration("9223372036854775808ns", ns));
+    CHECK_FALSE(wahl::parse_duration("106752d", ns));
+    CHECK_FALSE(wahl::parse_duration("99999999999999999999ns", ns));
+  }
+
+  SUBCASE("malformed values") {
+    for (auto x : {"", "5", "s", "5x", "5 s", "1.s", ".5s", "1..5s", "5s5",
+                   "1.5ns", "0.0000000001s", "-", "--5s", "5s/"})
+      CHECK_FALSE_MESSAGE(wahl::parse_duration(x, ns), x);
+  }
+}
+
+TEST_CASE("duration conversion") {
+  std::chrono::seconds s{};
+  CHECK(wahl::from_nanoseconds(2000000000, s));
+  CHECK_EQ(s, 2s);
+  CHECK_FALSE(wahl::from_nanoseconds(1500000000, s));
+
+  std::chrono::duration<long long, std::pico> ps{};
+  CHECK(wahl::from_nanoseconds(3, ps));
+  CHECK_EQ(ps.count(), 3000);
+  CHECK_FALSE(wahl::from_nanoseconds(std::numeric_limits<std::int64_t>::max(),
+                                     ps));
+
+  std::chrono::duration<unsigned, std::milli> unsigned_ms{};
+  CHECK_FALSE(wahl::from_nanoseconds(-1000000, unsigned_ms));
+  CHECK_FALSE(wahl::from_nanoseconds(5000000000000000, unsigned_ms));
+
+  std::chrono::duration<short, std::ratio<60>> minutes{};
+  CHECK(wahl::from_nanoseconds(120000000000, minutes));
+  CHECK_EQ(minutes.count(), 2);
+}
+
+TEST_CASE("byte size parsing") {
+  std::uint64_t result = 0;
+
+  SUBCASE("SI and IEC units") {
+    CHECK_EQ(bytes("512"), 512);
+    CHECK_EQ(bytes("512B"), 512);
+    CHECK_EQ(bytes("4kB"), 4000);
+    CHECK_EQ(bytes("4KB"), 4000);
+    CHECK_EQ(bytes("4KiB"), 4096);
+    CHECK_EQ(bytes("3MB"), 3000000);
+    CHECK_EQ(bytes("3MiB"), 3145728);
+    CHECK_EQ(bytes("4GiB"), std::uint64_t{4} << 30);
+    CHECK_EQ(bytes("2TB"), 2000000000000);
+    CHECK_EQ(bytes("1PiB"), std::uint64_t{1} << 50);
+    CHECK_EQ(bytes("15EiB"), std::uint64_t{15} << 60);
+    CHECK_EQ(bytes("1.5GiB"), std::uint64_t{3} << 29);
+    CHECK_EQ(bytes("0.5kB"), 500);
+  }
+
+  SUBCASE("overflow and inexact values") {
+    CHECK_EQ(bytes("18446744073709551615"),
+             std::numeric_limits<std::uint64_t>::max());
+    CHECK_FALSE(wahl::parse_byte_size("18446744073709551616", result));
+    CHECK_FALSE(wahl::parse_byte_size("16EiB", result));
+    CHECK_FALSE(wahl::parse_byte_size("19EB", result));
+    CHECK_FALSE(wahl::parse_byte_size("15.99999EiB", result));
+    CHECK_FALSE(wahl::parse_byte_size("0.1KiB", result));
+    CHECK_FALSE(wahl::parse_byte_size("1.5", result));
+  }
+
+  SUBCASE("malformed values") {
+    for (auto x : {"", "B", "4kb", "4Kb", "4 GiB", "-4GiB", "4GiBs", "4Gi"})
+      CHECK_FALSE_MESSAGE(wahl::parse_byte_size(x, result), x);
+  }
+}
+
+TEST_CASE("quantity and rate parsing") {
+  std::uint64_t count = 0;
+  std::int64_t period = 0;
+
+  CHECK_EQ(quantity("250"), 250);
+  CHECK_EQ(quantity("10k"), 10000);
+  CHECK_EQ(quantity("10K"), 10000);
+  CHECK_EQ(quantity("2.5M"), 2500000);
+  CHECK_EQ(quantity("18E"), 18000000000000000000u);
+  CHECK_FALSE(wahl::parse_quantity("19E", count));
+  CHECK_FALSE(wahl::parse_quantity("1.5", count));
+  CHECK_FALSE(wahl::parse_quantity("10Ki", count));
+
+  REQUIRE(wahl::parse_rate("10k/s", count, period));
+  CHECK_EQ(count, 10000);
+  CHECK_EQ(period, 1000000000);
+  REQUIRE(wahl::parse_rate("500/100ms", count, period));
+  CHECK_EQ(count, 500);
+  CHECK_EQ(period, 100000000);
+  REQUIRE(wahl::parse_rate("1M/h", count, period));
+  CHECK_EQ(period, 3600000000000);
+  REQUIRE(wahl::parse_rate("30", count, period));
+  CHECK_EQ(count, 30);
+  CHECK_EQ(period, 1000000000);
+  for (auto x : {"", "/s", "10/", "10/0s", "10/x", "10k/s/s", "10/5"})
+    CHECK_FALSE_MESSAGE(wahl::parse_rate(x, count, period), x);
+}
+
+TEST_CASE("unit arguments") {
+  auto cmd = service_cmd{};
+
+  SUBCASE("values are converted") {
+    wahl::parse(cmd, {"-t", "1.5s", "--grace=250ms", "--cache", "4GiB",
+                      "--batch", "2k", "--rate", "10k/s", "--retry", "1s",
+                      "1m"});
+    CHECK_EQ(cmd.timeout, 1500ms);
+    CHECK_EQ(cmd.grace.count(), doctest::Approx(0.25));
+    CHECK_EQ(cmd.cache.bytes, std::uint64_t{4} << 30);
+    CHECK_EQ(cmd.batch.value, 2000);
+    CHECK_EQ(cmd.limit.per_second(), doctest::Approx(10000));
+    CHECK_EQ(cmd.retries, std::vector<std::chrono::seconds>{1s, 60s});
+  }
+
+  SUBCASE("invalid values are errors") {
+    auto r = wahl::parse(std::nothrow, cmd, {"--cache", "1GiB", "-t", "5x"});
+    REQUIRE_FALSE(r);
+    CHECK_EQ(r.error().code(), wahl::error_code::invalid_value);
+    CHECK_EQ(r.error().index(), 3);
+    CHECK_EQ(r.error().message(), "invalid value: 5x");
+
+    r = wahl::parse(std::nothrow, cmd, {"--timeout", "1us"});
+    REQUIRE_FALSE(r);
+    CHECK_EQ(r.error().token(), "1us");
+  }
+
+  SUBCASE("metavars name the units") {
+    CHECK_EQ(wahl::type_to_help(cmd.timeout), "[duration]");
+    CHECK_EQ(wahl::type_to_help(cmd.cache), "[size]");
+    CHECK_EQ(wahl::type_to_help(cmd.batch), "[count]");
+    CHECK_EQ(wahl::type_to_help(cmd.limit), "[rate]");
+    CHECK_EQ(wahl::type_to_help(cmd.retries), "[duration...]");
+  }
+}
@@ -0,0 +1,84 @@
+// SPDX-License-Identifier: BSL-1.0
+
+#include <wahl/wahl.hpp>
+#include <doctest/doctest.h>
+
+#include <filesystem>
+#include <fstream>
+
+namespace {
+
+struct temporary_file {
+  std::filesystem::path path;
+
+  explicit temporary_file(const std::string &content) {
+    static int counter = 0;
+    path = std::filesystem::temp_directory_path() /
+           ("wahl-values-" + std::to_string(++counter) + ".txt");
+    std::ofstream(path, std::ios::binary) << content;
+  }
+
+  ~temporary_file() { std::filesystem::remove(path); }
+};
+
+struct ids_cmd {
+  std::vector<int> ids = {};
+  std::vector<std::string> paths = {};
+
+  template <class F> void parse(F f) {
+    f(ids, "--id", "-I");
+    f(ids, "--ids-from", wahl::values_from_file());
+    f(paths, "--paths-from", wahl::values_from_file());
+  }
+
+  void run() {}
+};
+
+} // namespace
+
+TEST_CASE("values from file") {
+  auto cmd = ids_cmd{};
+
+  SUBCASE("one value per line") {
+    temporary_file file("1\n2\r\n\n3");
+    wahl::parse(cmd, {"--ids-from", file.path.string()});
+    CHECK_EQ(cmd.ids, std::vector<int>{1, 2, 3});
+  }
+
+  SUBCASE("values from files are appended to the container") {
+    temporary_file file("2\n3\n");
+    wahl::parse(cmd, {"--id", "1", "--ids-from=" + file.path.string(), "-I4"});
+    CHECK_EQ(cmd.ids, std::vector<int>{1, 2, 3, 4});
+  }
+
+  SUBCASE("lines spanning multiple chunks") {
+    std::string content;
+    std::vector<std::string> expected;
+    for (int i = 0; i < 20000; ++i) {
+      expected.push_back("path/" + std::to_string(i));
+      content += expected.back() + "\n";
+    }
+    temporary_file file(content);
+    wahl::parse(cmd, {"--paths-from", file.path.string()});
+    CHECK_EQ(cmd.paths, expected);
+  }
+
+  SUBCASE("strings keep the whole line") {
+    temporary_file file("my documents/a b.txt\r\n  indented\n\nlast one");
+    wahl::parse(cmd, {"--paths-from", file.path.string()});
+    CHECK_EQ(cmd.paths, std::vector<std::string>{"my documents/a b.txt",
+                                                 "  indented", "last one"});
+  }
+
+  SUBCASE("invalid values are reported with their line number") {
+    temporary_file file("1\n2\nthree\n");
+    auto message = file.path.string() + ":3: invalid value: three";
+    CHECK_THROWS_WITH(wahl::parse(cmd, {"--ids-from", file.path.string()}),
+                      message.c_str());
+  }
+
+  SUBCASE("missing files are reported") {
+    CHECK_THROWS_WITH(wahl::parse(cmd, {"--ids-from", "/does/not/exist"}),
+                      "cannot open file: /does/not/exist");
+  }
+}